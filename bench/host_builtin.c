@@ -0,0 +1,8 @@
+// 宿主机（x86_64）上运行基准程序用的 builtin 实现，与 ir_test 的 host stub 一致
+#include <stdio.h>
+#include <stdlib.h>
+long printInt(long x){printf("%ld", x);return x;}
+long printlnInt(long x){printf("%ld\n", x);return x;}
+long printlnStr(const char *s){printf("%s\n", s ? s : "");return 0;}
+long getInt(void){long v=0;if(scanf("%ld", &v)!=1)v=0;return v;}
+__attribute__((noreturn)) void exit_rt(long code){exit((int)code);}
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <vector>
 using std::string;
 using std::unique_ptr;
@@ -13,10 +14,15 @@ constexpr int DumpSpaceNumber = 4;
 // 前向声明
 class ExprAST;
 class StmtAST;
+struct TypeInfo;
+struct FunctionInfo;
+struct StructInfo;
 
 // 类型AST基类
 class TypeAST {
 public:
+    const TypeInfo *resolved = nullptr; // 语义分析时解析一次后缓存的类型，后续阶段直接复用
+
     virtual ~TypeAST() = default;
     virtual void dump(int indent = 0) const = 0;
     virtual string toString() const = 0;
@@ -89,6 +95,10 @@ public:
 class ExprAST {
 public:
   size_t pos;
+  // 语义分析结果直接挂在节点上，IR 生成读取时无需再查表
+  const TypeInfo *resolved_type = nullptr; // 推导出的表达式类型
+  bool const_checked = false; // const_value 是否已求值
+  std::optional<int64_t> const_value; // 编译期整数常量值
 
   ExprAST() = default;
   ExprAST(size_t);
@@ -232,6 +242,8 @@ class MemberAccessExprAST : public ExprAST {
 public:
   unique_ptr<ExprAST> struct_expr;
   string member_name;
+  const StructInfo *owner = nullptr; // 语义分析解析出的所属结构体
+  int field_index = -1; // 字段在 StructInfo::orderedFields 中的下标，-1 表示未解析
 
   MemberAccessExprAST(size_t, unique_ptr<ExprAST>, const string&);
   void dump(int indent) const override;
@@ -244,6 +256,8 @@ public:
   std::vector<unique_ptr<ExprAST> > args;
   // 成员方法调用的对象表达式，如果是普通函数调用则为nullptr
   unique_ptr<ExprAST> object_expr;
+  FunctionInfo *callee = nullptr; // 语义分析解析出的被调函数或方法
+  string mangled; // 方法调用解析出的符号名（Type__method），普通函数调用为空
 
   // 普通函数调用构造函数
   CallExprAST(const string &, size_t, std::vector<unique_ptr<ExprAST> >);
@@ -268,6 +282,8 @@ public:
   string type_name;
   string method_name;
   std::vector<unique_ptr<ExprAST>> args;
+  FunctionInfo *callee = nullptr; // 语义分析解析出的关联函数
+  string mangled; // 解析 Self 后的符号名（Type__method）
 
   StaticCallExprAST(const string &, const string &, size_t, std::vector<unique_ptr<ExprAST>>);
   void dump(int indent) const override;
@@ -353,11 +369,10 @@ public:
 
 class LetStmtAST : public StmtAST {
 public:
-  unique_ptr<PatternAST> pattern;
-  string type; // 类型注解
+  unique_ptr<PatternAST> pattern; // 类型注解保存在 IdentPatternAST::type
   unique_ptr<ExprAST> value;
 
-  LetStmtAST(unique_ptr<PatternAST>, const string&, unique_ptr<ExprAST>, size_t);
+  LetStmtAST(unique_ptr<PatternAST>, unique_ptr<ExprAST>, size_t);
   void dump(int indent) const override;
 };
 
@@ -413,12 +428,14 @@ public:
 class FnStmtAST : public StmtAST {
 public:
   string name;
-  std::vector<std::pair<std::unique_ptr<IdentPatternAST>, std::string>> params;
+  std::vector<std::unique_ptr<IdentPatternAST>> params; // 参数类型保存在 IdentPatternAST::type（self 为 Self）
   unique_ptr<TypeAST> return_type;
   bool is_const;
   unique_ptr<BlockStmtAST> body;
+  bool declares_local_types = false; // 函数体（含嵌套函数）内声明了 struct/enum，由 Parser 标记
+  uint64_t content_hash = 0; // 整个函数（签名与函数体）的记号哈希，由 Parser 填写，IR 缓存用
 
-  FnStmtAST(const string &, std::vector<std::pair<std::unique_ptr<IdentPatternAST>, std::string>>&&, unique_ptr<TypeAST>, unique_ptr<BlockStmtAST>, bool, size_t);
+  FnStmtAST(const string &, std::vector<std::unique_ptr<IdentPatternAST>>&&, unique_ptr<TypeAST>, unique_ptr<BlockStmtAST>, bool, size_t);
 
   void dump(int indent) const override;
 };
@@ -435,10 +452,10 @@ public:
 class StaticStmtAST : public StmtAST {
 public:
   string name;
-  string type;
+  unique_ptr<TypeAST> type;
   unique_ptr<ExprAST> value;
   bool is_mut;
-  StaticStmtAST(const string &, const string &, unique_ptr<ExprAST>, bool, size_t);
+  StaticStmtAST(const string &, unique_ptr<TypeAST>, unique_ptr<ExprAST>, bool, size_t);
   void dump(int indent) const override;
 };
 
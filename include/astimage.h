@@ -0,0 +1,50 @@
+#ifndef ASTIMAGE_H
+#define ASTIMAGE_H
+
+/**
+ * 类型化AST的二进制映像
+ *
+ * 把语义分析后的AST（连同类型标注、被调函数、字段下标等结果）与语义表
+ * （StructInfo、EnumInfo、FunctionInfo、常量值）写成紧凑的版本化二进制文件。
+ * 加载时直接映射文件并顺序解码，随后即可运行IR生成，跳过词法、语法和语义分析。
+ *
+ * 文件布局：魔数 + 版本号，其后依次为字符串表、类型表、语义表和前序排列的节点流。
+ * 整数均为LEB128变长编码；字符串、类型、函数在节点流中以表内下标引用。
+ */
+
+#include <memory>
+#include <string>
+#include "ast.h"
+#include "semantic.h"
+
+class AstImage {
+public:
+  // 映像格式版本，节点或语义表的编码有变化时递增
+  static constexpr uint32_t kVersion = 1;
+
+  /**
+   * 把已通过语义分析的程序写成映像文件
+   *
+   * @param path 输出文件路径
+   * @param program 程序的AST根节点
+   * @param analyzer 完成分析的语义分析器
+   * @throws std::runtime_error 当AST含有无法编码的节点或文件无法写入时
+   */
+  static void save(const std::string &path, BlockStmtAST *program, const SemanticAnalyzer &analyzer);
+
+  /**
+   * 加载映像文件，重建AST并把语义表装入analyzer（装入前先 reset）
+   *
+   * @param path 映像文件路径
+   * @param analyzer 接收语义表的分析器，加载后可直接交给 IRGen
+   * @return 程序的AST根节点
+   * @throws std::runtime_error 当文件无法读取、魔数或版本不符、内容截断或损坏时
+   */
+  static std::unique_ptr<BlockStmtAST> load(const std::string &path, SemanticAnalyzer &analyzer);
+
+private:
+  struct Encoder;
+  struct Decoder;
+};
+
+#endif // ASTIMAGE_H
@@ -0,0 +1,65 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+/**
+ * 基准程序（compiler_bench、runtime_bench）共用的小工具：
+ * 重复测量的统计摘要，以及读取 JSON 基线文件
+ */
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace BenchUtil {
+  struct Stats {
+    double median = 0;
+    double p90 = 0;
+    double min = 0;
+  };
+
+  /**
+   * 线性插值的百分位数
+   * @param samples 已排序的样本
+   * @param p 0 到 1 之间
+   */
+  double percentile(const std::vector<double> &samples, double p);
+
+  // 中位数、p90 与最小值；样本为空时全为 0
+  Stats summarize(std::vector<double> samples);
+
+  /**
+   * JSON 值：基线文件只用到对象、字符串和数字，按这个子集表示
+   */
+  struct JsonValue {
+    double number = 0;
+    std::string text;
+    std::map<std::string, JsonValue> members;
+    bool isObject = false;
+
+    const JsonValue *get(const std::string &key) const {
+      auto it = members.find(key);
+      return it == members.end() ? nullptr : &it->second;
+    }
+
+    // 成员存在且为数字时返回其值，否则返回 fallback
+    double number_or(const std::string &key, double fallback) const;
+  };
+
+  /**
+   * 解析 JSON 文本（不支持数组、true/false/null）
+   * @throws std::runtime_error 格式错误时
+   */
+  JsonValue parse_json(std::string_view text);
+
+  /**
+   * 读入整个文件
+   * @return 文件无法打开时返回 false
+   */
+  bool read_file(const std::string &path, std::string &out);
+
+  // 按 JSON 字符串字面量写出（加引号并转义）
+  std::string json_quote(std::string_view s);
+}
+
+#endif // BENCHUTIL_H
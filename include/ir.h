@@ -9,13 +9,18 @@
  * 本实现生成文本形式的LLVM IR，无需链接LLVM库。
  */
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <vector>
 #include "ast.h"
 #include "semantic.h"
 
@@ -27,7 +32,7 @@
  *
  * @param program 程序的AST根节点
  * @param analyzer 语义分析器，包含类型信息和符号表
- * @param inputPath 输入文件路径，用于错误报告
+ * @param inputPath 输入文件路径；非空时 IR 另写入同名 .ll 文件
  * @param emitLLVM 是否输出LLVM IR
  * @return 是否成功生成IR
  * @throws std::exception 当遇到不支持的AST/类型或IO错误时
@@ -50,6 +55,45 @@ namespace IRGen {
     bool arrayLike = false; // true for arrays (including array fields)
   };
 
+  // 结构体字段布局：(字段名, 字节偏移, 槽数, 类型, 存储位宽)，顺序与 orderedFields 一致。
+  // 标量字段按自身位宽自然对齐存放，聚合字段占整数个 i64 槽
+  using FieldLayout = std::tuple<std::string, size_t, size_t, TypeRef, unsigned>;
+
+  // 生成函数体时登记的模块级需求。每个函数各记一份，writeModule 按函数顺序合并
+  struct ModuleNeeds {
+    bool needsMemset = false;
+    bool needsMemcpy = false;
+    bool needsMalloc = false;
+    bool needsIdxClamp = false;
+    std::unordered_map<std::string, size_t> declArity; // 被调函数 -> 见到的最多实参个数
+    std::vector<std::string> staticGlobals; // 提升到 .bss 的大局部变量定义
+
+    void merge(ModuleNeeds &&other);
+  };
+
+  // 一次 IR 生成的模块级状态：开始生成函数体之前全部算好，生成期间只读，
+  // 因此各函数可以在不同线程上同时生成
+  struct ModuleCtx {
+    SemanticAnalyzer *analyzer = nullptr;
+    bool bitPackActive = false; // g_bitPackBools 且程序中没有对 bool 数组元素取地址
+    std::unordered_map<const StructInfo *, std::unordered_set<size_t> > borrowedFields; // 程序中出现过 &v.f 的字段下标
+    std::unordered_set<std::string> nonReentrantFuncs; // 不可重入函数，其大局部变量可提升为全局变量
+    std::unordered_map<const StructInfo *, std::vector<FieldLayout> > structLayouts;
+    bool layoutsFrozen = false; // structLayouts 已预先算好，之后只读
+    std::mutex lateLayoutsMutex;
+    std::unordered_map<const StructInfo *, std::vector<FieldLayout> > lateLayouts; // 冻结后才遇到的结构体
+    std::unordered_map<std::string, std::vector<size_t> > paramMaxSlots; // 按参数类型标注推出的参数槽数
+    std::unordered_set<std::string> definedFuncs;
+    ModuleNeeds needs; // 各函数产出合并后的结果
+    uint64_t cacheEnvHash = 0; // 启用 IR 缓存时：模块内全部签名、布局、常量的哈希
+  };
+
+  // 函数级 IR 缓存的命中统计（--stats 打印）
+  struct IRCacheStats {
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+  };
+
   struct FunctionCtx {
     std::string name;
     bool returnsVoid = false;
@@ -63,18 +107,23 @@ namespace IRGen {
     std::string currentLabel;
 
     struct VarInfo {
-      TypeRef type;
+      TypeRef type = nullptr;
       TypeLayout layout;
       std::string ptr;
       bool arrayAlloca = false;
       bool isRefBinding = false; // true when the variable stores a reference (raw pointer)
       bool refIsRawSlot = false; // true if the reference pointer itself is stored in the alloca slot
+      bool isStatic = false; // true when storage is a promoted zero-initialized global
+      std::vector<std::string> fieldPtrs; // SROA: per-field scalar slots indexed by field offset; empty otherwise
     };
 
     std::unordered_map<std::string, VarInfo> vars;
+    std::unordered_set<std::string> sroaVars; // locals whose struct value is split into per-field scalars
+    Value destHint; // RVO: storage the next aggregate rvalue may be built in directly (the caller's %ret)
     std::string breakLabel;
     std::string continueLabel;
     bool terminated = false;
+    ModuleNeeds needs; // 本函数登记的模块级需求
   };
 
   //for debug, write to .ll
@@ -96,17 +145,36 @@ namespace IRGen {
   void emitStmt(FunctionCtx &fn, StmtAST *stmt);
 
   // 全局变量声明
-  extern std::unordered_map<std::string, size_t> g_declArity;
-  extern std::unordered_set<std::string> g_definedFuncs;
-  extern SemanticAnalyzer *g_analyzer;
+  extern thread_local ModuleCtx *g_module; // 当前线程正在生成的模块，生成线程各自绑定
+  extern bool g_bitPackBools; // 可选：[bool; N] 数组按位压缩存储（--bitpack-bools）
+  extern unsigned g_emitThreads; // 并行生成函数的线程数，0 表示按硬件并发数
+  extern std::string g_irCacheDir; // 非空时启用函数级 IR 磁盘缓存（--ir-cache=<目录>）
+  extern IRCacheStats g_irCacheStats;
 
   TypeRef exprType(ExprAST *expr);
   std::optional<int64_t> constInt(ExprAST *e);
   Value fallbackValue();
   Value emitNumber(int64_t v);
   Value emitBool(bool v);
+  const char *builtinCSource(); // 运行时 builtin.c 的源码
   void emitBuiltinCToStderr();
 
   bool generate_ir(BlockStmtAST *program, SemanticAnalyzer &analyzer, const std::string &inputPath, bool emitLLVM);
+
+  /**
+   * 批量编译用：生成 IR 写入 inputPath 对应的 .ll 文件，不向标准输出打印
+   *
+   * 模块状态绑定在调用线程上，不同源文件可在多个线程上同时生成。
+   *
+   * @throws std::exception 当遇到不支持的AST/类型或无法写入 .ll 时
+   */
+  void write_ir_file(BlockStmtAST *program, SemanticAnalyzer &analyzer, const std::string &inputPath);
+
+  /**
+   * 服务模式用：生成 IR 并以字符串返回，不写文件也不打印
+   *
+   * @throws std::exception 当遇到不支持的AST/类型时
+   */
+  std::string generate_ir_text(BlockStmtAST *program, SemanticAnalyzer &analyzer);
 }
 #endif // IR_H
@@ -14,6 +14,35 @@
 #include "token.h"
 #include <vector>
 #include <string>
+#include <string_view>
+
+/**
+ * 行首偏移索引
+ *
+ * 对源代码扫描一次，记录每一行起始的字节偏移；
+ * 之后任意阶段都可以用二分查找把字节偏移换算为行号和列号（均从1开始）。
+ */
+class LineIndex {
+public:
+  LineIndex() = default;
+
+  explicit LineIndex(std::string_view src);
+
+  /**
+   * 根据字节偏移获取行号和列号
+   * @param pos 字节偏移
+   * @return 行号和列号的pair
+   */
+  std::pair<int, int> lookup(size_t pos) const;
+
+  /**
+   * 格式化为 "line L, column C"，供诊断信息使用
+   */
+  std::string describe(size_t pos) const;
+
+private:
+  std::vector<size_t> lineStarts_{0}; // 每行起始偏移，第一行总是 0
+};
 
 /**
  * 词法分析器类
@@ -25,9 +54,12 @@ class Lexer {
 public:
   /**
    * 构造词法分析器
-   * @param src 源代码字符串
+   *
+   * 不复制源代码：词法分析直接在 src 所指的内存（如映射的源文件）上进行，
+   * 因此 src 须在 Lexer 使用期间保持有效。生成的 Token 自带文本，不受此限。
+   * @param src 源代码
    */
-  Lexer(const std::string &);
+  Lexer(std::string_view);
 
   /**
    * 获取下一个标记
@@ -54,6 +86,11 @@ public:
    */
   std::pair<int, int> getLineAndCol(int);
 
+  /**
+   * 构造时建立的行首索引，供语法分析、语义分析等后续阶段换算诊断位置
+   */
+  const LineIndex &line_index() const { return lines_; }
+
 private:
   /**
    * 前进到下一个字符
@@ -68,7 +105,7 @@ private:
    * @param matched 匹配结果
    * @return 是否匹配成功
    */
-  bool match(const boost::regex &, const std::string &, size_t &, std::string &);
+  bool match(const boost::regex &, std::string_view, size_t &, std::string &);
 
   /**
    * 跳过空白字符
@@ -80,8 +117,9 @@ private:
    */
   void skip_comment();
 
-  std::string src_;  // 源代码字符串
+  std::string_view src_;  // 源代码视图
   size_t pos_;       // 当前位置
   char currentChar;   // 当前字符
+  LineIndex lines_;  // 行首偏移索引
 };
 #endif //LEXER_H
@@ -0,0 +1,47 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+/**
+ * 只读文件映射
+ *
+ * 把整个文件只读映射进内存，调用方直接在映射上读取，不经过中间缓冲区复制。
+ * 没有 mmap 的平台（或映射失败、空文件）退回为一次性读入内部缓冲区，接口不变。
+ */
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * 打开并映射文件，之前映射的内容随之释放
+   * @param path 文件路径
+   * @return 文件无法打开时返回 false
+   */
+  bool open(const std::string &path);
+
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  /**
+   * 文件内容视图，在 MappedFile 析构或重新 open 之前有效
+   */
+  std::string_view view() const { return {reinterpret_cast<const char *>(data_), size_}; }
+
+private:
+  void release();
+
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::string buffer_; // 退回路径下的文件内容
+};
+
+#endif // MAPPEDFILE_H
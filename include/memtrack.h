@@ -0,0 +1,44 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+/**
+ * 编译器自身的分阶段内存统计（--mem-report）
+ *
+ * memtrack.cpp 替换全局 operator new/delete，把每次分配记到本线程当前所在的
+ * TimeTrace 阶段（最内层的 Scope）上：分配次数、请求字节数，以及该阶段进行中
+ * 堆上存活字节的峰值；每个阶段结束时再采样一次进程的峰值 RSS。
+ * 未启用时 operator new/delete 只多检查一次全局开关。该文件只链接进编译器主程序。
+ */
+
+#include <ostream>
+
+namespace MemTrack {
+  /**
+   * 开始统计，并以只跟踪阶段的方式启用 TimeTrace；须在启动工作线程之前调用
+   */
+  void enable();
+
+  bool enabled();
+
+  /**
+   * 打印各阶段的分配次数、字节数、存活峰值与 RSS 峰值
+   */
+  void printReport(std::ostream &out);
+
+  /**
+   * 命令行 --mem-report 的会话：构造时按需启用，析构时把报告打印到 stderr
+   */
+  class Session {
+  public:
+    explicit Session(bool report);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+  private:
+    bool report_;
+  };
+}
+
+#endif // MEMTRACK_H
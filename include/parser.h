@@ -8,22 +8,41 @@
 class Parser {
   std::vector<Token> tokens;
   int pos;
+  const LineIndex *lines; // 词法分析建立的行首索引，用于把报错位置换算为行列；可为空
+  size_t type_decls = 0; // 已解析的 struct/enum 声明数，用来标记函数体内是否含局部类型
 
 public:
-  Parser(std::vector<Token> tokens_) : tokens(std::move(tokens_)), pos(0) {
+  Parser(std::vector<Token> tokens_, const LineIndex *lines_ = nullptr)
+    : tokens(std::move(tokens_)), pos(0), lines(lines_) {
+  }
+
+  // 诊断位置描述：有行首索引时给出行列，否则退回字节偏移
+  std::string where(size_t position) const {
+    return lines ? lines->describe(position) : "position " + std::to_string(position);
   }
 
   Token &current() { return tokens[pos]; }
   void advance() { if (pos < tokens.size() - 1) ++pos; }
   void retreat() { if (pos > 0) --pos; }
 
+  // 记号区间 [begin, end) 的内容哈希（忽略位置），函数级 IR 缓存据此判断函数是否改动
+  uint64_t hash_tokens(size_t begin, size_t end) const;
+
   bool match(TokenKind kind, const std::string &text = "") {
     return current().kind() == kind && (text.empty() || current().text() == text);
   }
 
+  // 当前记号是否为赋值或复合赋值运算符
+  bool match_assign_op() {
+    if (current().kind() != TokenKind::Operator) return false;
+    const std::string &op = current().text();
+    return op == "=" || op == "+=" || op == "-=" || op == "*=" || op == "/=" || op == "%=" ||
+           op == "&=" || op == "|=" || op == "^=" || op == "<<=" || op == ">>=";
+  }
+
   void expect(TokenKind kind, const std::string &text = "") {
     if (!match(kind, text)) {
-      std::string error_msg = "Unexpected token: " + current().text() + " at position " + std::to_string(current().position());
+      std::string error_msg = "Unexpected token: " + current().text() + " at " + where(current().position());
       throw std::runtime_error(error_msg);
     }
     advance();
@@ -36,7 +55,7 @@ public:
       advance();
       return name;
     }
-    std::string error_msg = "Expected identifier, but got: " + current().text() + " at position " + std::to_string(current().position());
+    std::string error_msg = "Expected identifier, but got: " + current().text() + " at " + where(current().position());
     throw std::runtime_error(error_msg);
   }
 
@@ -139,12 +158,12 @@ public:
       return make_unique<PrimitiveTypeAST>("Self");
     }
 
-    std::string error_msg = "Expected type identifier, but got: " + current().text() + " at position " + std::to_string(current().position());
+    std::string error_msg = "Expected type identifier, but got: " + current().text() + " at " + where(current().position());
     throw std::runtime_error(error_msg);
   }
 
-  std::vector<std::pair<std::unique_ptr<IdentPatternAST>, std::string>> parse_fn_params() {
-    std::vector<std::pair<std::unique_ptr<IdentPatternAST>, std::string>> params;
+  std::vector<std::unique_ptr<IdentPatternAST>> parse_fn_params() {
+    std::vector<std::unique_ptr<IdentPatternAST>> params;
     if (!match(TokenKind::Punctuation, ")")) { // 空参
       // 检查是否是 self 参数（实例方法）
       // 注意：在 Rust 中，self 参数必须是第一个参数
@@ -172,9 +191,10 @@ public:
         
         // 创建self参数的IdentPatternAST对象
         auto self_pattern = std::make_unique<IdentPatternAST>("self", self_is_mut, self_is_ref, false, current().position());
+        self_pattern->type = make_unique<PrimitiveTypeAST>("Self");
         
         // 添加self参数
-        params.emplace_back(std::move(self_pattern), "Self");
+        params.push_back(std::move(self_pattern));
         
         // 如果还有其他参数，需要逗号分隔
         if (!match(TokenKind::Punctuation, ")")) {
@@ -215,18 +235,8 @@ public:
         // 冒号
         expect(TokenKind::Punctuation, ":");
         
-        // 参数类型
+        // 参数类型（&/&mut 前缀记录在模式的 is_ref/is_mut 上）
         auto type_ast = parse_type();
-        std::string type_name = type_ast->toString();
-        
-        // 如果是引用，需要将引用符号添加到类型前
-        if (is_ref) {
-          if (is_mut) {
-            type_name = "&mut " + type_name;
-          } else {
-            type_name = "&" + type_name;
-          }
-        }
         
         // 创建IdentPatternAST对象
         auto pattern = std::make_unique<IdentPatternAST>(param_name, is_mut, is_ref, false, current().position());
@@ -235,14 +245,14 @@ public:
         pattern->type = std::move(type_ast);
         
         // 添加参数到列表
-        params.emplace_back(std::move(pattern), type_name);
+        params.push_back(std::move(pattern));
         // 下一个参数/结束
         if (match(TokenKind::Punctuation, ",")) {
           advance();
         } else if (match(TokenKind::Punctuation, ")")) {
           break; // 参数列表结束
         } else {
-          std::string error_msg = "Unexpected token in function parameter list: " + current().text() + " at position " + std::to_string(current().position());
+          std::string error_msg = "Unexpected token in function parameter list: " + current().text() + " at " + where(current().position());
           throw std::runtime_error(error_msg);
         }
       }
@@ -263,19 +273,12 @@ public:
 
   unique_ptr<ExprAST> parse_expr();
 
-  unique_ptr<ExprAST> parse_logical();
-
-  unique_ptr<ExprAST> parse_bitwise();
-
-  unique_ptr<ExprAST> parse_equality();
-
-  unique_ptr<ExprAST> parse_comparison();
-
-  unique_ptr<ExprAST> parse_shift();
+  // 按优先级表解析二元运算，只吸收优先级不低于min_prec的运算符
+  unique_ptr<ExprAST> parse_binary(int min_prec);
 
-  unique_ptr<ExprAST> parse_additive();
+  unique_ptr<ExprAST> parse_binary_rhs(int min_prec, unique_ptr<ExprAST> lhs);
 
-  unique_ptr<ExprAST> parse_term();
+  unique_ptr<ExprAST> parse_expr_rest(unique_ptr<ExprAST> lhs);
 
   unique_ptr<ExprAST> parse_cast_expr();
 
@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -28,14 +29,15 @@ enum class BaseType {
 };
 
 struct TypeInfo;
-using TypeRef = std::shared_ptr<TypeInfo>;
+// 非拥有的类型句柄：TypeInfo 由类型工厂的驻留表统一持有，生命期覆盖整次编译，句柄可按值随意拷贝
+using TypeRef = const TypeInfo *;
 
 struct TypeInfo {
   BaseType kind = BaseType::Unknown;
   std::string name; // 结构体、枚举或自定义类型名
   std::vector<TypeRef> parameters; // 函数参数或复合类型成分
-  TypeRef returnType; // 函数返回类型
-  TypeRef elementType; // 数组元素类型
+  TypeRef returnType = nullptr; // 函数返回类型
+  TypeRef elementType = nullptr; // 数组元素类型
   bool isMutableRef = false; // 引用是否可变
   bool isUnsigned = false; // 整型是否为无符号
   int bitWidth = 0; // 整型位宽（0 表示未指定）
@@ -51,6 +53,7 @@ struct TypeInfo {
   bool isBool() const { return kind == BaseType::Bool; }
 };
 
+// 所有类型经哈希驻留：结构相同的类型只存在一份且创建后不可修改，同一类型可直接按指针比较
 namespace TypeFactory {
   TypeRef getInt();
 
@@ -81,6 +84,9 @@ namespace TypeFactory {
   TypeRef makeEnum(const std::string &name);
 
   TypeRef makeCustom(const std::string &name);
+
+  // 按完整描述驻留（成分类型须已驻留），加载 AST 映像时重建类型用
+  TypeRef intern(const TypeInfo &proto);
 }
 
 //===----------------------------------------------------------------------===//
@@ -95,7 +101,7 @@ enum class SymbolKind {
 struct Symbol {
   std::string name;
   SymbolKind kind;
-  TypeRef type;
+  TypeRef type = nullptr;
   bool isMutable = false;
 };
 
@@ -112,7 +118,16 @@ public:
   const Symbol *lookupCurrent(const std::string &name) const;
 
 private:
-  std::vector<std::unordered_map<std::string, Symbol> > scopes_;
+  // 扁平符号表：所有作用域共用一张名字索引，每个名字指向最内层绑定，绑定之间串成遮蔽链
+  struct Binding {
+    Symbol symbol;
+    size_t depth; // 所属作用域深度
+    int shadowed; // 被遮蔽的外层同名绑定下标，-1 表示无
+  };
+
+  std::deque<Binding> bindings_; // 按声明顺序追加，兼作撤销日志；deque 保证已返回的 Symbol 指针稳定
+  std::vector<size_t> scopeMarks_; // 每层作用域开始时 bindings_ 的长度
+  std::unordered_map<std::string, int> heads_; // 名字 -> 当前可见绑定下标（-1 表示已全部出作用域）
 };
 
 //===----------------------------------------------------------------------===//
@@ -121,11 +136,12 @@ struct StructInfo {
   std::string name;
   std::unordered_map<std::string, TypeRef> fields;
   std::vector<std::pair<std::string, TypeRef> > orderedFields;
+  std::unordered_map<std::string, size_t> fieldIndex; // 字段名 -> orderedFields 下标
 };
 
 struct EnumVariant {
   std::string name;
-  TypeRef payload; // nullptr
+  TypeRef payload = nullptr;
 };
 
 struct EnumInfo {
@@ -137,10 +153,10 @@ struct FunctionInfo {
   std::string name;
   std::vector<TypeRef> params;
   std::vector<bool> paramMut;
-  TypeRef returnType;
+  TypeRef returnType = nullptr;
   bool isMethod = false;
   bool hasSelf = false;
-  TypeRef receiverType; // for methods
+  TypeRef receiverType = nullptr; // for methods
   bool selfIsReference = false;
   bool selfIsMutable = false;
 };
@@ -148,6 +164,8 @@ struct FunctionInfo {
 struct SemanticIssue {
   std::string message;
   size_t position = 0;
+  int line = 0; // 行号，未提供行首索引时为 0
+  int column = 0; // 列号，未提供行首索引时为 0
 };
 
 //===----------------------------------------------------------------------===//
@@ -160,6 +178,12 @@ public:
 
   const std::vector<SemanticIssue> &errors() const { return issues; }
 
+  // 设置词法分析建立的行首索引，报错时据此记录行列
+  void setLineIndex(const LineIndex *index) { lineIndex = index; }
+
+  // 函数体并行分析的线程数，0 表示按硬件并发数
+  void setWorkerThreads(unsigned count) { workerThreads = count; }
+
   // 生命周期管理
   void reset() {
     symbols = SymbolTable();
@@ -169,11 +193,13 @@ public:
     enums.clear();
     functions.clear();
     methods.clear();
-    currentReturn.reset();
+    currentReturn = nullptr;
     currentImplType.clear();
     loopDepth = 0;
     constIntValues.clear();
-    exprTypes.clear();
+    localFunctions.clear();
+    localConstValues.clear();
+    retiredLocalFunctions.clear();
     registerBuiltins();
   }
 
@@ -204,6 +230,11 @@ public:
 
   void collectFunctionDeclarations(BlockStmtAST *program);
 
+  // 函数体内声明的局部 struct/enum 在并行分析前统一登记
+  void collectLocalTypeDeclarations(StmtAST *stmt);
+
+  void collectLocalTypeDeclarations(ExprAST *expr);
+
   void registerStruct(StructStmtAST *structStmt);
 
   void registerEnum(EnumStmtAST *enumStmt);
@@ -222,6 +253,9 @@ public:
 
   void analyzeFunctionBody(FnStmtAST *fn, const std::string &ownerType = "");
 
+  // 在线程池上分析一批互不依赖的函数体，诊断按声明顺序合并
+  void analyzeFunctionBodies(const std::vector<std::pair<FnStmtAST *, std::string> > &jobs);
+
   // 语句/表达式
   void analyzeStatement(StmtAST *stmt);
 
@@ -282,8 +316,11 @@ public:
 
   TypeRef resolveType(TypeAST *typeAst, const std::string &selfType);
 
+  // 仅解析单个类型名（基本类型 / Self / 结构体 / 枚举），复合类型由 resolveType 按 TypeAST 结构解析
   TypeRef resolveTypeName(const std::string &name, const std::string &selfType = "");
 
+  TypeRef resolveParamType(IdentPatternAST *param, const std::string &selfType);
+
   void reportError(size_t position, const std::string &msg);
 
   bool ensureAssignable(const TypeRef &from, const TypeRef &to, size_t position, ExprAST *originExpr = nullptr);
@@ -300,9 +337,6 @@ public:
 
   bool tryEvaluateConstInt(ExprAST *expr, int64_t &value) const;
 
-  // Evaluate a constant integer expression provided as a raw string (used for array lengths in type annotations).
-  bool evaluateConstLengthExpr(const std::string &expr, int64_t &value) const;
-
   bool isNumericLiteral(ExprAST *expr) const;
 
   bool exprGuaranteesReturn(ExprAST *expr) const;
@@ -315,8 +349,6 @@ public:
 
   void ensureIntLiteralFits(ExprAST *expr, const TypeRef &targetType, size_t position);
 
-  TypeRef getCachedExprType(ExprAST *expr);
-
   // lookup helpers
   FunctionInfo *findFunction(const std::string &name);
 
@@ -326,19 +358,42 @@ public:
 
   const std::unordered_map<std::string, StructInfo> &getStructTable() const { return structs; }
 
+  const std::unordered_map<std::string, EnumInfo> &getEnumTable() const { return enums; }
+
+  const std::unordered_map<std::string, FunctionInfo> &getFunctionTable() const { return functions; }
+
+  const std::unordered_map<std::string, std::unordered_map<std::string, FunctionInfo> > &getMethodTable() const {
+    return methods;
+  }
+
+  const std::unordered_map<std::string, int64_t> &getConstValues() const { return constIntValues; }
+
 private:
+  friend class AstImage; // 映像读写直接访问声明表
+
+  // worker：共享 parent 的声明表，复制其全局作用域与常量表
+  explicit SemanticAnalyzer(SemanticAnalyzer *parent);
+
   SymbolTable symbols;
   std::vector<SemanticIssue> issues;
+  const LineIndex *lineIndex = nullptr;
   std::unordered_map<std::string, StructInfo> structs;
   std::unordered_map<std::string, EnumInfo> enums;
   std::unordered_map<std::string, FunctionInfo> functions;
   std::unordered_map<std::string, std::unordered_map<std::string, FunctionInfo> > methods;
-  TypeRef currentReturn;
+  TypeRef currentReturn = nullptr;
   std::string currentImplType;
   std::string currentFunctionName;
   int loopDepth = 0;
   std::unordered_map<std::string, int64_t> constIntValues;
-  std::unordered_map<ExprAST *, TypeRef> exprTypes;
+  // 声明表的持有者；worker 指向主分析器，函数体分析期间只读
+  SemanticAnalyzer *root = this;
+  unsigned workerThreads = 0;
+  // worker 内登记的局部函数与局部常量，分析完一个函数体后交给主分析器合并
+  std::unordered_map<std::string, FunctionInfo> localFunctions;
+  std::unordered_map<std::string, int64_t> localConstValues;
+  // 合并时因重名未并入 functions 的局部函数；调用点的 callee 仍指向这些节点
+  std::vector<std::unordered_map<std::string, FunctionInfo> > retiredLocalFunctions;
 };
 
 #endif // SEMANTIC_H
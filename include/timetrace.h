@@ -0,0 +1,130 @@
+#ifndef TIMETRACE_H
+#define TIMETRACE_H
+
+/**
+ * 编译器自身的分阶段计时（--time-trace / --time-report）
+ *
+ * 在各阶段放置 TimeTrace::Scope：构造时记下开始时间，析构时记录一条事件，
+ * 嵌套的 Scope 自然形成层次。未启用时 Scope 只检查一次全局开关，不读时钟也不复制名字。
+ * 事件先写入各线程自己的缓冲区，结束时汇总为 Chrome/Perfetto trace JSON 或摘要表。
+ * Scope 同时维护本线程当前所在的阶段，供内存统计（memtrack.h）归属分配。
+ */
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace TimeTrace {
+  namespace detail {
+    // 两个开关都只在启动工作线程之前设置，之后只读
+    extern bool g_enabled; // Scope 生效：维护当前阶段
+    extern bool g_recordEvents; // 记录计时事件
+    extern thread_local constinit const char *t_phase; // 本线程最内层的阶段，不在任何阶段时为空
+    int64_t now(); // 自启用以来的纳秒数
+    void finish(const char *name, std::string &&detail, int64_t start);
+  }
+
+  /**
+   * 启用阶段跟踪
+   * @param recordEvents 为 false 时只维护当前阶段，不读时钟也不记录事件；多次调用取并集
+   */
+  void enable(bool recordEvents = true);
+
+  inline bool enabled() { return detail::g_enabled; }
+
+  // 本线程当前所在的阶段名，未启用或不在任何阶段时为空
+  inline const char *currentPhase() { return detail::t_phase; }
+
+  /**
+   * 设置阶段结束时的回调（在该线程恢复外层阶段之后调用），nullptr 表示清除
+   */
+  using PhaseHook = void (*)(const char *name);
+  void setPhaseEndHook(PhaseHook hook);
+
+  /**
+   * 计时作用域
+   *
+   * name 须为字符串字面量等静态存储的字符串；detail（如函数名）只在启用时复制。
+   */
+  class Scope {
+  public:
+    explicit Scope(const char *name) {
+      if (detail::g_enabled) begin(name);
+    }
+
+    Scope(const char *name, std::string_view text) {
+      if (detail::g_enabled) {
+        if (detail::g_recordEvents) detail_ = text;
+        begin(name);
+      }
+    }
+
+    // detail 记为 owner::name，owner 为空时只记 name；用于方法
+    Scope(const char *name, std::string_view owner, std::string_view fnName) {
+      if (detail::g_enabled) {
+        if (detail::g_recordEvents) {
+          if (!owner.empty()) {
+            detail_ = owner;
+            detail_ += "::";
+          }
+          detail_ += fnName;
+        }
+        begin(name);
+      }
+    }
+
+    ~Scope() {
+      if (name_) {
+        detail::t_phase = outer_;
+        detail::finish(name_, std::move(detail_), start_);
+      }
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    void begin(const char *name) {
+      name_ = name;
+      outer_ = detail::t_phase;
+      detail::t_phase = name;
+      if (detail::g_recordEvents) start_ = detail::now();
+    }
+
+    const char *name_ = nullptr; // 未启用时为空
+    const char *outer_ = nullptr;
+    std::string detail_;
+    int64_t start_ = 0;
+  };
+
+  /**
+   * 写出 Chrome trace 格式的 JSON，可在 chrome://tracing 或 Perfetto 中打开
+   * @return 文件无法写入时返回 false
+   */
+  bool writeChromeTrace(const std::string &path);
+
+  /**
+   * 打印摘要表：按阶段汇总总耗时与次数，并列出最慢的若干函数
+   */
+  void printReport(std::ostream &out);
+
+  /**
+   * 命令行计时选项的会话：构造时按需启用，析构时写出 trace 文件和摘要，
+   * 因此 main 的任一返回路径都会输出
+   */
+  class Session {
+  public:
+    Session(std::string tracePath, bool report);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+  private:
+    std::string tracePath_;
+    bool report_;
+  };
+}
+
+#endif // TIMETRACE_H
@@ -82,9 +82,9 @@ public:
   
   /**
    * 获取标记文本内容
-   * @return 标记文本内容
+   * @return 标记文本内容（返回引用，比较时不复制）
    */
-  std::string text() const;
+  const std::string &text() const;
 
   /**
    * 获取标记在源代码中的位置
@@ -408,18 +408,14 @@ void ExprStmtAST::dump(int indent) const {
 }
 
 
-LetStmtAST::LetStmtAST(unique_ptr<PatternAST> pattern_, const string& type_, unique_ptr<ExprAST> value_, size_t pos_) : StmtAST(pos_),
-  pattern(std::move(pattern_)), type(type_), value(std::move(value_)) {
+LetStmtAST::LetStmtAST(unique_ptr<PatternAST> pattern_, unique_ptr<ExprAST> value_, size_t pos_) : StmtAST(pos_),
+  pattern(std::move(pattern_)), value(std::move(value_)) {
 }
 
 void LetStmtAST::dump(int indent) const {
   dump_space(indent);
   std::cout << "LetStmt:\n";
   pattern->dump(indent + DumpSpaceNumber);
-  if (!type.empty()) {
-    dump_space(indent + DumpSpaceNumber);
-    std::cout << "Type: " << type << '\n';
-  }
   if (value) {
     value->dump(indent + DumpSpaceNumber);
   } else {
@@ -556,7 +552,7 @@ void BlockStmtAST::dump(int indent) const {
 }
 
 
-FnStmtAST::FnStmtAST(const string &name_, std::vector<std::pair<std::unique_ptr<IdentPatternAST>, std::string>>&& params_, unique_ptr<TypeAST> return_type_,
+FnStmtAST::FnStmtAST(const string &name_, std::vector<std::unique_ptr<IdentPatternAST>>&& params_, unique_ptr<TypeAST> return_type_,
                      unique_ptr<BlockStmtAST> body_, bool is_const_, size_t pos_) : StmtAST(pos_), name(name_), params(std::move(params_)),
                                                                     return_type(std::move(return_type_)), is_const(is_const_), body(std::move(body_)) {
 }
@@ -565,9 +561,9 @@ void FnStmtAST::dump(int indent) const {
   dump_space(indent);
   std::cout << "FnStmt: " << name << "(";
   for (int i = 0; i < params.size(); ++i) {
-    std::cout << "name:" << params[i].first->name << " type:" << params[i].second;
-    if (params[i].first->is_mut) std::cout << " mut";
-    if (params[i].first->is_ref) std::cout << " ref";
+    std::cout << "name:" << params[i]->name << " type:" << (params[i]->type ? params[i]->type->toString() : "");
+    if (params[i]->is_mut) std::cout << " mut";
+    if (params[i]->is_ref) std::cout << " ref";
     if (i < params.size() - 1) std::cout << ", ";
   }
   std::cout << ") ->" << (return_type ? return_type->toString() : "void") << '\n';
@@ -589,14 +585,14 @@ void ConstStmtAST::dump(int indent) const {
   value->dump(indent + DumpSpaceNumber);
 }
 
-StaticStmtAST::StaticStmtAST(const string &name_, const string &type_, unique_ptr<ExprAST> value_, bool is_mut_,
-                             size_t pos_) : StmtAST(pos_), name(name_), type(type_), value(std::move(value_)),
+StaticStmtAST::StaticStmtAST(const string &name_, unique_ptr<TypeAST> type_, unique_ptr<ExprAST> value_, bool is_mut_,
+                             size_t pos_) : StmtAST(pos_), name(name_), type(std::move(type_)), value(std::move(value_)),
                                             is_mut(is_mut_) {
 }
 
 void StaticStmtAST::dump(int indent) const {
   dump_space(indent);
-  std::cout << "StaticStmtAST: " << name << ' ' << type << '\n';
+  std::cout << "StaticStmtAST: " << name << ' ' << (type ? type->toString() : "") << '\n';
   value->dump(indent + DumpSpaceNumber);
 }
 
@@ -0,0 +1,998 @@
+#include "astimage.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mappedfile.h"
+
+namespace {
+  constexpr char kMagic[8] = {'R', 'C', 'A', 'S', 'T', 'I', 'M', 'G'};
+
+  // 节点标签，写在每个节点开头；0 表示空指针
+  enum class Tag : uint8_t {
+    Null = 0,
+    PrimitiveType, ArrayType, ReferenceType, TupleType, EnumType,
+    Number, Float, Variable, IfExpr, BlockExpr, LoopExpr, ReturnExpr, String, Bool, EnumExpr,
+    Unary, Binary, ArrayIndex, MemberAccess, Call, StructExpr, StaticCall, EnumValue, Cast, ArrayExpr,
+    IdentPattern,
+    ExprStmt, Let, Assign, IfStmt, While, For, Block, Fn, Const, Static, ReturnStmt, Break, Continue,
+    LoopStmt, Exit, Struct, Enum, Impl
+  };
+
+  void putVar(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+      out.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+
+  // zigzag：小的负数也只占一两个字节
+  void putSigned(std::string &out, int64_t v) {
+    putVar(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+  }
+
+  void putTag(std::string &out, Tag tag) {
+    out.push_back(static_cast<char>(tag));
+  }
+
+  template<class Map>
+  std::vector<typename Map::const_pointer> sortedEntries(const Map &map) {
+    std::vector<typename Map::const_pointer> entries;
+    entries.reserve(map.size());
+    for (const auto &entry: map) entries.push_back(&entry);
+    std::sort(entries.begin(), entries.end(), [](auto a, auto b) { return a->first < b->first; });
+    return entries;
+  }
+
+  [[noreturn]] void fail(const std::string &what) {
+    throw std::runtime_error("AST image: " + what);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Encoder
+//===----------------------------------------------------------------------===//
+
+struct AstImage::Encoder {
+  const SemanticAnalyzer &analyzer;
+  std::string strings; // 字符串表
+  std::string types; // 类型表：成分类型总在引用它的类型之前
+  std::string body; // 语义表 + 节点流
+  std::unordered_map<std::string, uint64_t> stringIds;
+  std::unordered_map<TypeRef, uint64_t> typeIds;
+  std::unordered_map<const FunctionInfo *, uint64_t> functionIds;
+
+  explicit Encoder(const SemanticAnalyzer &analyzer_) : analyzer(analyzer_) {}
+
+  void str(std::string &out, const std::string &s) {
+    auto it = stringIds.find(s);
+    if (it == stringIds.end()) {
+      it = stringIds.emplace(s, stringIds.size()).first;
+      putVar(strings, s.size());
+      strings += s;
+    }
+    putVar(out, it->second);
+  }
+
+  // 类型按下标 + 1 引用，0 表示空
+  uint64_t typeId(TypeRef type) {
+    if (!type) return 0;
+    auto it = typeIds.find(type);
+    if (it != typeIds.end()) return it->second;
+    std::vector<uint64_t> params;
+    for (TypeRef param: type->parameters) params.push_back(typeId(param));
+    const uint64_t ret = typeId(type->returnType);
+    const uint64_t elem = typeId(type->elementType);
+    types.push_back(static_cast<char>(type->kind));
+    str(types, type->name);
+    putVar(types, params.size());
+    for (uint64_t param: params) putVar(types, param);
+    putVar(types, ret);
+    putVar(types, elem);
+    types.push_back(static_cast<char>(type->isMutableRef | type->isUnsigned << 1 | type->hasArrayLength << 2));
+    putSigned(types, type->bitWidth);
+    putSigned(types, type->arrayLength);
+    const uint64_t id = typeIds.size() + 1;
+    typeIds.emplace(type, id);
+    return id;
+  }
+
+  void type(std::string &out, TypeRef t) {
+    putVar(out, typeId(t));
+  }
+
+  void function(const std::string &key, const FunctionInfo &info) {
+    functionIds.emplace(&info, functionIds.size() + 1);
+    str(body, key);
+    str(body, info.name);
+    putVar(body, info.params.size());
+    for (TypeRef param: info.params) type(body, param);
+    putVar(body, info.paramMut.size());
+    for (bool mut: info.paramMut) body.push_back(static_cast<char>(mut));
+    type(body, info.returnType);
+    body.push_back(static_cast<char>(info.isMethod | info.hasSelf << 1 | info.selfIsReference << 2 |
+                                     info.selfIsMutable << 3));
+    type(body, info.receiverType);
+  }
+
+  void functionTable(const std::unordered_map<std::string, FunctionInfo> &table) {
+    putVar(body, table.size());
+    for (const auto *entry: sortedEntries(table)) function(entry->first, entry->second);
+  }
+
+  // 各表按名字排序写出，同一程序的映像逐字节相同
+  void tables() {
+    putVar(body, analyzer.structs.size());
+    for (const auto *entry: sortedEntries(analyzer.structs)) {
+      str(body, entry->first);
+      str(body, entry->second.name);
+      putVar(body, entry->second.orderedFields.size());
+      for (const auto &[field, fieldType]: entry->second.orderedFields) {
+        str(body, field);
+        type(body, fieldType);
+      }
+    }
+    putVar(body, analyzer.enums.size());
+    for (const auto *entry: sortedEntries(analyzer.enums)) {
+      str(body, entry->first);
+      str(body, entry->second.name);
+      putVar(body, entry->second.variants.size());
+      for (const auto *variant: sortedEntries(entry->second.variants)) {
+        str(body, variant->first);
+        str(body, variant->second.name);
+        type(body, variant->second.payload);
+      }
+    }
+    functionTable(analyzer.functions);
+    putVar(body, analyzer.methods.size());
+    for (const auto *entry: sortedEntries(analyzer.methods)) {
+      str(body, entry->first);
+      functionTable(entry->second);
+    }
+    putVar(body, analyzer.retiredLocalFunctions.size());
+    for (const auto &table: analyzer.retiredLocalFunctions) functionTable(table);
+    putVar(body, analyzer.constIntValues.size());
+    for (const auto *entry: sortedEntries(analyzer.constIntValues)) {
+      str(body, entry->first);
+      putSigned(body, entry->second);
+    }
+  }
+
+  void callee(const FunctionInfo *info) {
+    if (!info) {
+      putVar(body, 0);
+      return;
+    }
+    auto it = functionIds.find(info);
+    if (it == functionIds.end()) fail("callee is not in the function tables");
+    putVar(body, it->second);
+  }
+
+  void typeNode(const TypeAST *node) {
+    if (!node) {
+      putTag(body, Tag::Null);
+      return;
+    }
+    auto header = [&](Tag tag) {
+      putTag(body, tag);
+      type(body, node->resolved);
+    };
+    if (auto *prim = dynamic_cast<const PrimitiveTypeAST *>(node)) {
+      header(Tag::PrimitiveType);
+      str(body, prim->name);
+    } else if (auto *array = dynamic_cast<const ArrayTypeAST *>(node)) {
+      header(Tag::ArrayType);
+      typeNode(array->element_type.get());
+      expr(array->size_expr.get());
+    } else if (auto *ref = dynamic_cast<const ReferenceTypeAST *>(node)) {
+      header(Tag::ReferenceType);
+      body.push_back(static_cast<char>(ref->is_mutable));
+      typeNode(ref->referenced_type.get());
+    } else if (auto *tuple = dynamic_cast<const TupleTypeAST *>(node)) {
+      header(Tag::TupleType);
+      putVar(body, tuple->elements.size());
+      for (const auto &elem: tuple->elements) typeNode(elem.get());
+    } else if (auto *enumType = dynamic_cast<const EnumTypeAST *>(node)) {
+      header(Tag::EnumType);
+      str(body, enumType->name);
+      putVar(body, enumType->variants.size());
+      for (const auto &[name, payload]: enumType->variants) {
+        str(body, name);
+        typeNode(payload.get());
+      }
+    } else {
+      fail("unsupported type node");
+    }
+  }
+
+  void exprList(const std::vector<unique_ptr<ExprAST> > &list) {
+    putVar(body, list.size());
+    for (const auto &e: list) expr(e.get());
+  }
+
+  void stmtList(const std::vector<unique_ptr<StmtAST> > &list) {
+    putVar(body, list.size());
+    for (const auto &s: list) stmt(s.get());
+  }
+
+  void expr(const ExprAST *node) {
+    if (!node) {
+      putTag(body, Tag::Null);
+      return;
+    }
+    // 公共部分：位置与语义分析的标注
+    auto header = [&](Tag tag) {
+      putTag(body, tag);
+      putVar(body, node->pos);
+      type(body, node->resolved_type);
+      body.push_back(static_cast<char>(node->const_checked | node->const_value.has_value() << 1));
+      if (node->const_value) putSigned(body, *node->const_value);
+    };
+    if (auto *number = dynamic_cast<const NumberExprAST *>(node)) {
+      header(Tag::Number);
+      putSigned(body, number->value);
+    } else if (auto *fl = dynamic_cast<const FloatExprAST *>(node)) {
+      header(Tag::Float);
+      uint64_t bits = 0;
+      std::memcpy(&bits, &fl->value, sizeof(bits));
+      putVar(body, bits);
+    } else if (auto *var = dynamic_cast<const VariableExprAST *>(node)) {
+      header(Tag::Variable);
+      str(body, var->name);
+    } else if (auto *ifExpr = dynamic_cast<const IfExprAST *>(node)) {
+      header(Tag::IfExpr);
+      expr(ifExpr->cond.get());
+      expr(ifExpr->then_branch.get());
+      expr(ifExpr->else_branch.get());
+    } else if (auto *block = dynamic_cast<const BlockExprAST *>(node)) {
+      header(Tag::BlockExpr);
+      stmtList(block->statements);
+      expr(block->value.get());
+    } else if (auto *loop = dynamic_cast<const LoopExprAST *>(node)) {
+      header(Tag::LoopExpr);
+      stmt(loop->body.get());
+    } else if (auto *ret = dynamic_cast<const ReturnExprAST *>(node)) {
+      header(Tag::ReturnExpr);
+      body.push_back(static_cast<char>(ret->propagates_return));
+      expr(ret->value.get());
+    } else if (auto *s = dynamic_cast<const StringExprAST *>(node)) {
+      header(Tag::String);
+      str(body, s->str);
+      body.push_back(static_cast<char>(s->is_char_literal));
+    } else if (auto *b = dynamic_cast<const BoolExprAST *>(node)) {
+      header(Tag::Bool);
+      body.push_back(static_cast<char>(b->value));
+    } else if (auto *en = dynamic_cast<const EnumExprAST *>(node)) {
+      header(Tag::EnumExpr);
+      str(body, en->enum_name);
+      str(body, en->variant_name);
+      expr(en->value.get());
+    } else if (auto *unary = dynamic_cast<const UnaryExprAST *>(node)) {
+      header(Tag::Unary);
+      str(body, unary->op);
+      expr(unary->expr.get());
+    } else if (auto *binary = dynamic_cast<const BinaryExprAST *>(node)) {
+      header(Tag::Binary);
+      str(body, binary->op);
+      expr(binary->left_expr.get());
+      expr(binary->right_expr.get());
+    } else if (auto *index = dynamic_cast<const ArrayIndexExprAST *>(node)) {
+      header(Tag::ArrayIndex);
+      expr(index->array_expr.get());
+      expr(index->index_expr.get());
+    } else if (auto *member = dynamic_cast<const MemberAccessExprAST *>(node)) {
+      header(Tag::MemberAccess);
+      expr(member->struct_expr.get());
+      str(body, member->member_name);
+      // 所属结构体按名字引用，加载时在重建的 structs 表中查回
+      body.push_back(static_cast<char>(member->owner != nullptr));
+      if (member->owner) str(body, member->owner->name);
+      putSigned(body, member->field_index);
+    } else if (auto *call = dynamic_cast<const CallExprAST *>(node)) {
+      header(Tag::Call);
+      str(body, call->call);
+      exprList(call->args);
+      expr(call->object_expr.get());
+      callee(call->callee);
+      str(body, call->mangled);
+    } else if (auto *structExpr = dynamic_cast<const StructExprAST *>(node)) {
+      header(Tag::StructExpr);
+      str(body, structExpr->name);
+      putVar(body, structExpr->fields.size());
+      for (const auto &[name, value]: structExpr->fields) {
+        str(body, name);
+        expr(value.get());
+      }
+    } else if (auto *staticCall = dynamic_cast<const StaticCallExprAST *>(node)) {
+      header(Tag::StaticCall);
+      str(body, staticCall->type_name);
+      str(body, staticCall->method_name);
+      exprList(staticCall->args);
+      callee(staticCall->callee);
+      str(body, staticCall->mangled);
+    } else if (auto *enumValue = dynamic_cast<const EnumValueExprAST *>(node)) {
+      header(Tag::EnumValue);
+      str(body, enumValue->enum_type);
+      str(body, enumValue->enum_value);
+    } else if (auto *cast = dynamic_cast<const CastExprAST *>(node)) {
+      header(Tag::Cast);
+      expr(cast->expr.get());
+      typeNode(cast->target_type.get());
+    } else if (auto *array = dynamic_cast<const ArrayExprAST *>(node)) {
+      header(Tag::ArrayExpr);
+      body.push_back(static_cast<char>(array->is_repeated));
+      exprList(array->elements);
+      expr(array->element.get());
+      expr(array->count.get());
+    } else {
+      fail("unsupported expression node");
+    }
+  }
+
+  void identPattern(const IdentPatternAST *pattern) {
+    putTag(body, Tag::IdentPattern);
+    putVar(body, pattern->pos);
+    str(body, pattern->name);
+    body.push_back(static_cast<char>(pattern->is_mut | pattern->is_ref << 1 | pattern->is_addr_of << 2));
+    typeNode(pattern->type.get());
+  }
+
+  void fn(const FnStmtAST *node) {
+    putTag(body, Tag::Fn);
+    putVar(body, node->pos);
+    str(body, node->name);
+    putVar(body, node->params.size());
+    for (const auto &param: node->params) identPattern(param.get());
+    typeNode(node->return_type.get());
+    body.push_back(static_cast<char>(node->is_const | node->declares_local_types << 1));
+    putVar(body, node->content_hash);
+    stmt(node->body.get());
+  }
+
+  void stmt(const StmtAST *node) {
+    if (!node) {
+      putTag(body, Tag::Null);
+      return;
+    }
+    auto header = [&](Tag tag) {
+      putTag(body, tag);
+      putVar(body, node->pos);
+    };
+    if (auto *exprStmt = dynamic_cast<const ExprStmtAST *>(node)) {
+      header(Tag::ExprStmt);
+      expr(exprStmt->expr.get());
+    } else if (auto *let = dynamic_cast<const LetStmtAST *>(node)) {
+      header(Tag::Let);
+      auto *pattern = dynamic_cast<const IdentPatternAST *>(let->pattern.get());
+      if (let->pattern && !pattern) fail("unsupported pattern node");
+      if (pattern) {
+        identPattern(pattern);
+      } else {
+        putTag(body, Tag::Null);
+      }
+      expr(let->value.get());
+    } else if (auto *assign = dynamic_cast<const AssignStmtAST *>(node)) {
+      header(Tag::Assign);
+      expr(assign->lhs_expr.get());
+      expr(assign->value.get());
+      str(body, assign->op);
+    } else if (auto *ifStmt = dynamic_cast<const IfStmtAST *>(node)) {
+      header(Tag::IfStmt);
+      expr(ifStmt->cond.get());
+      stmt(ifStmt->then_branch.get());
+      stmt(ifStmt->else_branch.get());
+    } else if (auto *whileStmt = dynamic_cast<const WhileStmtAST *>(node)) {
+      header(Tag::While);
+      expr(whileStmt->cond.get());
+      stmt(whileStmt->body.get());
+    } else if (auto *forStmt = dynamic_cast<const ForStmtAST *>(node)) {
+      header(Tag::For);
+      stmt(forStmt->init.get());
+      expr(forStmt->cond.get());
+      stmt(forStmt->incr.get());
+      stmt(forStmt->body.get());
+    } else if (auto *block = dynamic_cast<const BlockStmtAST *>(node)) {
+      header(Tag::Block);
+      stmtList(block->statements);
+    } else if (auto *fnStmt = dynamic_cast<const FnStmtAST *>(node)) {
+      fn(fnStmt);
+    } else if (auto *constStmt = dynamic_cast<const ConstStmtAST *>(node)) {
+      header(Tag::Const);
+      str(body, constStmt->name);
+      typeNode(constStmt->type.get());
+      expr(constStmt->value.get());
+    } else if (auto *staticStmt = dynamic_cast<const StaticStmtAST *>(node)) {
+      header(Tag::Static);
+      str(body, staticStmt->name);
+      typeNode(staticStmt->type.get());
+      expr(staticStmt->value.get());
+      body.push_back(static_cast<char>(staticStmt->is_mut));
+    } else if (auto *ret = dynamic_cast<const ReturnStmtAST *>(node)) {
+      header(Tag::ReturnStmt);
+      body.push_back(static_cast<char>(ret->is_implicit));
+      expr(ret->value.get());
+    } else if (auto *brk = dynamic_cast<const BreakStmtAST *>(node)) {
+      header(Tag::Break);
+      expr(brk->value.get());
+    } else if (dynamic_cast<const ContinueStmtAST *>(node)) {
+      header(Tag::Continue);
+    } else if (auto *loop = dynamic_cast<const LoopStmtAST *>(node)) {
+      header(Tag::LoopStmt);
+      stmt(loop->body.get());
+    } else if (auto *exitStmt = dynamic_cast<const ExitStmtAST *>(node)) {
+      header(Tag::Exit);
+      expr(exitStmt->value.get());
+    } else if (auto *structStmt = dynamic_cast<const StructStmtAST *>(node)) {
+      header(Tag::Struct);
+      str(body, structStmt->name);
+      putVar(body, structStmt->fields.size());
+      for (const auto &[name, fieldType]: structStmt->fields) {
+        str(body, name);
+        typeNode(fieldType.get());
+      }
+    } else if (auto *enumStmt = dynamic_cast<const EnumStmtAST *>(node)) {
+      header(Tag::Enum);
+      str(body, enumStmt->name);
+      putVar(body, enumStmt->variants.size());
+      for (const auto &[name, payload]: enumStmt->variants) {
+        str(body, name);
+        typeNode(payload.get());
+      }
+    } else if (auto *impl = dynamic_cast<const ImplStmtAST *>(node)) {
+      header(Tag::Impl);
+      str(body, impl->type_name);
+      str(body, impl->trait_name);
+      putVar(body, impl->methods.size());
+      for (const auto &method: impl->methods) fn(method.get());
+    } else {
+      fail("unsupported statement node");
+    }
+  }
+};
+
+void AstImage::save(const std::string &path, BlockStmtAST *program, const SemanticAnalyzer &analyzer) {
+  Encoder enc(analyzer);
+  enc.tables();
+  enc.stmt(program);
+
+  std::string header(kMagic, sizeof(kMagic));
+  for (int shift = 0; shift < 32; shift += 8) header.push_back(static_cast<char>(kVersion >> shift));
+  putVar(header, enc.stringIds.size());
+  std::string typeCount;
+  putVar(typeCount, enc.typeIds.size());
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) fail("cannot write " + path);
+  out << header << enc.strings << typeCount << enc.types << enc.body;
+  if (!out) fail("cannot write " + path);
+}
+
+//===----------------------------------------------------------------------===//
+// Decoder
+//===----------------------------------------------------------------------===//
+
+struct AstImage::Decoder {
+  const unsigned char *p;
+  const unsigned char *end;
+  SemanticAnalyzer &analyzer;
+  std::vector<std::string_view> strings; // 直接指向映射内存
+  std::vector<TypeRef> types;
+  std::vector<FunctionInfo *> functions;
+
+  Decoder(const unsigned char *begin, const unsigned char *end_, SemanticAnalyzer &analyzer_)
+      : p(begin), end(end_), analyzer(analyzer_) {}
+
+  uint8_t u8() {
+    if (p == end) fail("truncated");
+    return *p++;
+  }
+
+  uint64_t var() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const uint8_t byte = u8();
+      v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return v;
+    }
+    fail("malformed integer");
+  }
+
+  int64_t svar() {
+    const uint64_t v = var();
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+  }
+
+  bool flag() {
+    return u8() != 0;
+  }
+
+  // 元素个数不可能超过剩余字节数，据此挡住损坏文件里的巨大长度
+  size_t count() {
+    const uint64_t n = var();
+    if (n > static_cast<uint64_t>(end - p)) fail("truncated");
+    return static_cast<size_t>(n);
+  }
+
+  std::string str() {
+    const uint64_t id = var();
+    if (id >= strings.size()) fail("bad string index");
+    return std::string(strings[id]);
+  }
+
+  TypeRef type() {
+    const uint64_t id = var();
+    if (id > types.size()) fail("bad type index");
+    return id ? types[id - 1] : nullptr;
+  }
+
+  Tag tag() {
+    const uint8_t raw = u8();
+    if (raw > static_cast<uint8_t>(Tag::Impl)) fail("bad node tag");
+    return static_cast<Tag>(raw);
+  }
+
+  void header() {
+    if (static_cast<size_t>(end - p) < sizeof(kMagic) + 4 || std::memcmp(p, kMagic, sizeof(kMagic)) != 0) {
+      fail("not an AST image");
+    }
+    p += sizeof(kMagic);
+    uint32_t version = 0;
+    for (int shift = 0; shift < 32; shift += 8) version |= static_cast<uint32_t>(*p++) << shift;
+    if (version != kVersion) {
+      fail("version " + std::to_string(version) + " (expected " + std::to_string(kVersion) + ")");
+    }
+  }
+
+  void stringTable() {
+    const size_t n = count();
+    strings.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      const size_t len = count();
+      strings.emplace_back(reinterpret_cast<const char *>(p), len);
+      p += len;
+    }
+  }
+
+  // 逐条重新驻留：成分类型在前，得到的 TypeRef 与本进程中分析出的完全一致
+  void typeTable() {
+    const size_t n = count();
+    types.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      TypeInfo proto;
+      const uint8_t kind = u8();
+      if (kind > static_cast<uint8_t>(BaseType::Unknown)) fail("bad type kind");
+      proto.kind = static_cast<BaseType>(kind);
+      proto.name = str();
+      const size_t params = count();
+      for (size_t j = 0; j < params; ++j) proto.parameters.push_back(type());
+      proto.returnType = type();
+      proto.elementType = type();
+      const uint8_t flags = u8();
+      proto.isMutableRef = flags & 1;
+      proto.isUnsigned = flags & 2;
+      proto.hasArrayLength = flags & 4;
+      proto.bitWidth = static_cast<int>(svar());
+      proto.arrayLength = svar();
+      types.push_back(TypeFactory::intern(proto));
+    }
+  }
+
+  void functionTable(std::unordered_map<std::string, FunctionInfo> &table) {
+    const size_t n = count();
+    for (size_t i = 0; i < n; ++i) {
+      const std::string key = str();
+      FunctionInfo info;
+      info.name = str();
+      const size_t params = count();
+      for (size_t j = 0; j < params; ++j) info.params.push_back(type());
+      const size_t muts = count();
+      for (size_t j = 0; j < muts; ++j) info.paramMut.push_back(flag());
+      info.returnType = type();
+      const uint8_t flags = u8();
+      info.isMethod = flags & 1;
+      info.hasSelf = flags & 2;
+      info.selfIsReference = flags & 4;
+      info.selfIsMutable = flags & 8;
+      info.receiverType = type();
+      // unordered_map 节点地址稳定，可直接作为 callee
+      functions.push_back(&(table[key] = std::move(info)));
+    }
+  }
+
+  void tables() {
+    size_t n = count();
+    for (size_t i = 0; i < n; ++i) {
+      const std::string key = str();
+      StructInfo &info = analyzer.structs[key];
+      info.name = str();
+      const size_t fields = count();
+      for (size_t j = 0; j < fields; ++j) {
+        std::string field = str();
+        TypeRef fieldType = type();
+        info.fields[field] = fieldType;
+        info.fieldIndex[field] = info.orderedFields.size();
+        info.orderedFields.emplace_back(std::move(field), fieldType);
+      }
+    }
+    n = count();
+    for (size_t i = 0; i < n; ++i) {
+      const std::string key = str();
+      EnumInfo &info = analyzer.enums[key];
+      info.name = str();
+      const size_t variants = count();
+      for (size_t j = 0; j < variants; ++j) {
+        const std::string variantKey = str();
+        EnumVariant &variant = info.variants[variantKey];
+        variant.name = str();
+        variant.payload = type();
+      }
+    }
+    // reset 登记的 builtin 由映像中的同名条目覆盖
+    functionTable(analyzer.functions);
+    n = count();
+    for (size_t i = 0; i < n; ++i) {
+      const std::string owner = str();
+      functionTable(analyzer.methods[owner]);
+    }
+    n = count();
+    analyzer.retiredLocalFunctions.resize(n);
+    for (auto &table: analyzer.retiredLocalFunctions) functionTable(table);
+    n = count();
+    for (size_t i = 0; i < n; ++i) {
+      const std::string name = str();
+      analyzer.constIntValues[name] = svar();
+    }
+  }
+
+  FunctionInfo *callee() {
+    const uint64_t id = var();
+    if (id > functions.size()) fail("bad function index");
+    return id ? functions[id - 1] : nullptr;
+  }
+
+  unique_ptr<TypeAST> typeNode() {
+    const Tag t = tag();
+    if (t == Tag::Null) return nullptr;
+    const TypeRef resolved = type();
+    unique_ptr<TypeAST> node;
+    switch (t) {
+      case Tag::PrimitiveType:
+        node = make_unique<PrimitiveTypeAST>(str());
+        break;
+      case Tag::ArrayType: {
+        auto elem = typeNode();
+        auto size = expr();
+        node = make_unique<ArrayTypeAST>(std::move(elem), std::move(size));
+        break;
+      }
+      case Tag::ReferenceType: {
+        const bool mut = flag();
+        node = make_unique<ReferenceTypeAST>(typeNode(), mut);
+        break;
+      }
+      case Tag::TupleType: {
+        std::vector<unique_ptr<TypeAST> > elems(count());
+        for (auto &elem: elems) elem = typeNode();
+        node = make_unique<TupleTypeAST>(std::move(elems));
+        break;
+      }
+      case Tag::EnumType: {
+        const std::string name = str();
+        std::vector<std::pair<string, unique_ptr<TypeAST> > > variants(count());
+        for (auto &[variant, payload]: variants) {
+          variant = str();
+          payload = typeNode();
+        }
+        node = make_unique<EnumTypeAST>(name, std::move(variants));
+        break;
+      }
+      default:
+        fail("expected a type node");
+    }
+    node->resolved = resolved;
+    return node;
+  }
+
+  std::vector<unique_ptr<ExprAST> > exprList() {
+    std::vector<unique_ptr<ExprAST> > list(count());
+    for (auto &e: list) e = expr();
+    return list;
+  }
+
+  std::vector<unique_ptr<StmtAST> > stmtList() {
+    std::vector<unique_ptr<StmtAST> > list(count());
+    for (auto &s: list) s = stmt();
+    return list;
+  }
+
+  // 构造函数实参的求值顺序不定，读取一律先落到局部变量
+  unique_ptr<ExprAST> expr() {
+    const Tag t = tag();
+    if (t == Tag::Null) return nullptr;
+    const size_t pos = var();
+    const TypeRef resolved = type();
+    const uint8_t constFlags = u8();
+    std::optional<int64_t> constValue;
+    if (constFlags & 2) constValue = svar();
+
+    unique_ptr<ExprAST> node;
+    switch (t) {
+      case Tag::Number:
+        node = make_unique<NumberExprAST>(svar(), pos);
+        break;
+      case Tag::Float: {
+        const uint64_t bits = var();
+        double value = 0;
+        std::memcpy(&value, &bits, sizeof(value));
+        node = make_unique<FloatExprAST>(value, pos);
+        break;
+      }
+      case Tag::Variable:
+        node = make_unique<VariableExprAST>(str(), pos);
+        break;
+      case Tag::IfExpr: {
+        auto cond = expr();
+        auto thenBranch = expr();
+        auto elseBranch = expr();
+        node = make_unique<IfExprAST>(std::move(cond), std::move(thenBranch), std::move(elseBranch), pos);
+        break;
+      }
+      case Tag::BlockExpr: {
+        auto statements = stmtList();
+        auto value = expr();
+        node = make_unique<BlockExprAST>(std::move(statements), std::move(value), pos);
+        break;
+      }
+      case Tag::LoopExpr:
+        node = make_unique<LoopExprAST>(stmt(), pos);
+        break;
+      case Tag::ReturnExpr: {
+        const bool propagates = flag();
+        node = make_unique<ReturnExprAST>(pos, expr(), propagates);
+        break;
+      }
+      case Tag::String: {
+        const std::string s = str();
+        const bool isChar = flag();
+        node = make_unique<StringExprAST>(s, pos, isChar);
+        break;
+      }
+      case Tag::Bool:
+        node = make_unique<BoolExprAST>(flag(), pos);
+        break;
+      case Tag::EnumExpr: {
+        const std::string enumName = str();
+        const std::string variant = str();
+        node = make_unique<EnumExprAST>(enumName, variant, expr(), pos);
+        break;
+      }
+      case Tag::Unary: {
+        const std::string op = str();
+        node = make_unique<UnaryExprAST>(op, pos, expr());
+        break;
+      }
+      case Tag::Binary: {
+        const std::string op = str();
+        auto lhs = expr();
+        auto rhs = expr();
+        node = make_unique<BinaryExprAST>(op, pos, std::move(lhs), std::move(rhs));
+        break;
+      }
+      case Tag::ArrayIndex: {
+        auto array = expr();
+        auto index = expr();
+        node = make_unique<ArrayIndexExprAST>(pos, std::move(array), std::move(index));
+        break;
+      }
+      case Tag::MemberAccess: {
+        auto object = expr();
+        const std::string member = str();
+        auto access = make_unique<MemberAccessExprAST>(pos, std::move(object), member);
+        if (flag()) {
+          access->owner = analyzer.getStructInfo(str());
+          if (!access->owner) fail("member access of unknown struct");
+        }
+        access->field_index = static_cast<int>(svar());
+        node = std::move(access);
+        break;
+      }
+      case Tag::Call: {
+        const std::string name = str();
+        auto args = exprList();
+        auto object = expr();
+        auto call = make_unique<CallExprAST>(name, pos, std::move(object), std::move(args));
+        call->callee = callee();
+        call->mangled = str();
+        node = std::move(call);
+        break;
+      }
+      case Tag::StructExpr: {
+        const std::string name = str();
+        std::vector<std::pair<std::string, unique_ptr<ExprAST> > > fields(count());
+        for (auto &[field, value]: fields) {
+          field = str();
+          value = expr();
+        }
+        node = make_unique<StructExprAST>(name, std::move(fields), pos);
+        break;
+      }
+      case Tag::StaticCall: {
+        const std::string typeName = str();
+        const std::string method = str();
+        auto call = make_unique<StaticCallExprAST>(typeName, method, pos, exprList());
+        call->callee = callee();
+        call->mangled = str();
+        node = std::move(call);
+        break;
+      }
+      case Tag::EnumValue: {
+        const std::string enumType = str();
+        const std::string enumValue = str();
+        node = make_unique<EnumValueExprAST>(enumType, enumValue, pos);
+        break;
+      }
+      case Tag::Cast: {
+        auto inner = expr();
+        node = make_unique<CastExprAST>(std::move(inner), typeNode(), pos);
+        break;
+      }
+      case Tag::ArrayExpr: {
+        const bool repeated = flag();
+        auto array = make_unique<ArrayExprAST>(exprList(), pos);
+        array->element = expr();
+        array->count = expr();
+        array->is_repeated = repeated;
+        node = std::move(array);
+        break;
+      }
+      default:
+        fail("expected an expression node");
+    }
+    node->resolved_type = resolved;
+    node->const_checked = constFlags & 1;
+    node->const_value = constValue;
+    return node;
+  }
+
+  unique_ptr<IdentPatternAST> identPattern() {
+    if (tag() != Tag::IdentPattern) fail("expected a pattern node");
+    const size_t pos = var();
+    const std::string name = str();
+    const uint8_t flags = u8();
+    auto pattern = make_unique<IdentPatternAST>(name, flags & 1, flags & 2, flags & 4, pos);
+    pattern->type = typeNode();
+    return pattern;
+  }
+
+  // 调用前已读过 Tag::Fn
+  unique_ptr<FnStmtAST> fn() {
+    const size_t pos = var();
+    const std::string name = str();
+    std::vector<unique_ptr<IdentPatternAST> > params(count());
+    for (auto &param: params) param = identPattern();
+    auto returnType = typeNode();
+    const uint8_t flags = u8();
+    const uint64_t contentHash = var();
+    auto body = stmt();
+    auto *block = dynamic_cast<BlockStmtAST *>(body.get());
+    if (body && !block) fail("function body is not a block");
+    body.release();
+    auto node = make_unique<FnStmtAST>(name, std::move(params), std::move(returnType), unique_ptr<BlockStmtAST>(block),
+                                       flags & 1, pos);
+    node->declares_local_types = flags & 2;
+    node->content_hash = contentHash;
+    return node;
+  }
+
+  unique_ptr<StmtAST> stmt() {
+    const Tag t = tag();
+    if (t == Tag::Null) return nullptr;
+    if (t == Tag::Fn) return fn();
+    const size_t pos = var();
+    switch (t) {
+      case Tag::ExprStmt:
+        return make_unique<ExprStmtAST>(expr(), pos);
+      case Tag::Let: {
+        unique_ptr<PatternAST> pattern;
+        if (p != end && *p == static_cast<uint8_t>(Tag::Null)) {
+          ++p;
+        } else {
+          pattern = identPattern();
+        }
+        return make_unique<LetStmtAST>(std::move(pattern), expr(), pos);
+      }
+      case Tag::Assign: {
+        auto lhs = expr();
+        auto rhs = expr();
+        return make_unique<AssignStmtAST>(std::move(lhs), std::move(rhs), pos, str());
+      }
+      case Tag::IfStmt: {
+        auto cond = expr();
+        auto thenBranch = stmt();
+        auto elseBranch = stmt();
+        return make_unique<IfStmtAST>(std::move(cond), std::move(thenBranch), std::move(elseBranch), pos);
+      }
+      case Tag::While: {
+        auto cond = expr();
+        return make_unique<WhileStmtAST>(std::move(cond), stmt(), pos);
+      }
+      case Tag::For: {
+        auto init = stmt();
+        auto cond = expr();
+        auto incr = stmt();
+        auto body = stmt();
+        return make_unique<ForStmtAST>(std::move(init), std::move(cond), std::move(incr), std::move(body), pos);
+      }
+      case Tag::Block:
+        return make_unique<BlockStmtAST>(stmtList(), pos);
+      case Tag::Const: {
+        const std::string name = str();
+        auto constType = typeNode();
+        return make_unique<ConstStmtAST>(name, std::move(constType), expr(), pos);
+      }
+      case Tag::Static: {
+        const std::string name = str();
+        auto staticType = typeNode();
+        auto value = expr();
+        const bool mut = flag();
+        return make_unique<StaticStmtAST>(name, std::move(staticType), std::move(value), mut, pos);
+      }
+      case Tag::ReturnStmt: {
+        const bool implicit = flag();
+        return make_unique<ReturnStmtAST>(pos, expr(), implicit);
+      }
+      case Tag::Break:
+        return make_unique<BreakStmtAST>(pos, expr());
+      case Tag::Continue:
+        return make_unique<ContinueStmtAST>(pos);
+      case Tag::LoopStmt:
+        return make_unique<LoopStmtAST>(stmt(), pos);
+      case Tag::Exit:
+        return make_unique<ExitStmtAST>(pos, expr());
+      case Tag::Struct:
+      case Tag::Enum: {
+        const std::string name = str();
+        std::vector<std::pair<string, unique_ptr<TypeAST> > > members(count());
+        for (auto &[member, memberType]: members) {
+          member = str();
+          memberType = typeNode();
+        }
+        if (t == Tag::Struct) return make_unique<StructStmtAST>(name, std::move(members), pos);
+        return make_unique<EnumStmtAST>(name, std::move(members), pos);
+      }
+      case Tag::Impl: {
+        const std::string typeName = str();
+        const std::string traitName = str();
+        std::vector<unique_ptr<FnStmtAST> > methods(count());
+        for (auto &method: methods) {
+          if (tag() != Tag::Fn) fail("impl member is not a function");
+          method = fn();
+        }
+        return make_unique<ImplStmtAST>(typeName, traitName, std::move(methods), pos);
+      }
+      default:
+        fail("expected a statement node");
+    }
+  }
+};
+
+std::unique_ptr<BlockStmtAST> AstImage::load(const std::string &path, SemanticAnalyzer &analyzer) {
+  MappedFile file;
+  if (!file.open(path)) fail("cannot open " + path);
+  Decoder dec(file.data(), file.data() + file.size(), analyzer);
+  dec.header();
+  dec.stringTable();
+  dec.typeTable();
+  analyzer.reset();
+  dec.tables();
+  auto root = dec.stmt();
+  auto *program = dynamic_cast<BlockStmtAST *>(root.get());
+  if (!program) fail("root is not a block");
+  if (dec.p != dec.end) fail("trailing bytes");
+  root.release();
+  return std::unique_ptr<BlockStmtAST>(program);
+}
@@ -0,0 +1,146 @@
+#include "benchutil.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace BenchUtil {
+  double percentile(const std::vector<double> &samples, double p) {
+    if (samples.empty()) return 0;
+    const double rank = p * static_cast<double>(samples.size() - 1);
+    const size_t lo = static_cast<size_t>(rank);
+    const size_t hi = std::min(lo + 1, samples.size() - 1);
+    return samples[lo] + (samples[hi] - samples[lo]) * (rank - static_cast<double>(lo));
+  }
+
+  Stats summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    Stats s;
+    if (samples.empty()) return s;
+    s.median = percentile(samples, 0.5);
+    s.p90 = percentile(samples, 0.9);
+    s.min = samples.front();
+    return s;
+  }
+
+  double JsonValue::number_or(const std::string &key, double fallback) const {
+    const JsonValue *value = get(key);
+    return value && !value->isObject && value->text.empty() ? value->number : fallback;
+  }
+
+  namespace {
+    class JsonReader {
+    public:
+      explicit JsonReader(std::string_view text) : text_(text) {}
+
+      JsonValue parse() {
+        JsonValue value = parse_value();
+        skip_space();
+        if (pos_ != text_.size()) fail("trailing characters");
+        return value;
+      }
+
+    private:
+      [[noreturn]] void fail(const std::string &what) const {
+        throw std::runtime_error("baseline JSON: " + what + " at offset " + std::to_string(pos_));
+      }
+
+      void skip_space() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+      }
+
+      void expect(char c) {
+        skip_space();
+        if (pos_ >= text_.size() || text_[pos_] != c) fail(std::string("expected '") + c + "'");
+        ++pos_;
+      }
+
+      std::string parse_string() {
+        expect('"');
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+          if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) ++pos_;
+          out += text_[pos_++];
+        }
+        expect('"');
+        return out;
+      }
+
+      JsonValue parse_value() {
+        skip_space();
+        if (pos_ >= text_.size()) fail("unexpected end");
+        JsonValue value;
+        if (text_[pos_] == '{') {
+          ++pos_;
+          value.isObject = true;
+          skip_space();
+          if (pos_ < text_.size() && text_[pos_] == '}') {
+            ++pos_;
+            return value;
+          }
+          while (true) {
+            std::string key = parse_string();
+            expect(':');
+            value.members[key] = parse_value();
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+              ++pos_;
+              continue;
+            }
+            expect('}');
+            return value;
+          }
+        }
+        if (text_[pos_] == '"') {
+          value.text = parse_string();
+          return value;
+        }
+        // strtod 依赖结尾的 NUL；数字很短，复制一份再转换
+        size_t end = pos_;
+        while (end < text_.size() && text_[end] != '\0' && std::strchr("+-.0123456789eE", text_[end])) ++end;
+        const std::string digits(text_.substr(pos_, end - pos_));
+        char *stop = nullptr;
+        value.number = std::strtod(digits.c_str(), &stop);
+        if (digits.empty() || *stop != '\0') fail("unsupported value");
+        pos_ = end;
+        return value;
+      }
+
+      std::string_view text_;
+      size_t pos_ = 0;
+    };
+  }
+
+  JsonValue parse_json(std::string_view text) {
+    return JsonReader(text).parse();
+  }
+
+  bool read_file(const std::string &path, std::string &out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  std::string json_quote(std::string_view s) {
+    std::string out = "\"";
+    for (char c: s) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+    return out;
+  }
+}
@@ -0,0 +1,377 @@
+// src/compiler_bench.cpp
+// 编译器吞吐基准：在进程内分别计时词法、语法、语义分析与 IR 生成，
+// 输入为 test_case 下的全部 .rx 以及按规模合成的程序；可与保存的 JSON 基线比较。
+//
+// 用法：compiler_bench [选项] [过滤子串...]
+//   --runs=N               计时轮数（默认 5），每轮把整个套件完整跑一遍
+//   --warmup=N             不计时的预热轮数（默认 1）
+//   --scale=N[,N...]       合成程序的函数个数，每个规模一个套件（默认 100,1000；0 表示不合成）
+//   --corpus=<目录>        语料根目录（默认在当前目录与可执行文件附近查找 test_case）
+//   --baseline=<文件>      与基线比较，任一阶段中位数变慢超过阈值即返回 1
+//   --threshold=X          回归阈值，相对变化（默认 0.10，即 10%）
+//   --write-baseline=<文件> 把本次结果写成基线
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "ir.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+  enum Phase { kLex, kParse, kSemantic, kIRGen, kPhaseCount };
+  const char *const kPhaseNames[kPhaseCount] = {"lex", "parse", "semantic", "irgen"};
+
+  struct Input {
+    std::string name;
+    std::string source;
+    size_t tokens = 0;
+  };
+
+  struct Suite {
+    std::string name;
+    std::vector<Input> inputs;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t reached[kPhaseCount] = {}; // 预热时各阶段实际执行的输入数（语料中有预期失败的程序）
+    std::vector<double> samples[kPhaseCount]; // 每轮整个套件在该阶段的总耗时（秒）
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  /**
+   * 对一个输入跑完整流水线，把各阶段耗时累加到 elapsed
+   * 某阶段失败（语法错误、语义错误、IR 不支持的特性）时后续阶段不再执行
+   * @return 实际执行到的阶段数
+   */
+  int run_pipeline(Input &input, double elapsed[kPhaseCount]) {
+    int done = 0;
+    try {
+      auto start = Clock::now();
+      Lexer lexer(input.source);
+      std::vector<Token> tokens = lexer.tokenize_all();
+      elapsed[kLex] += seconds_since(start);
+      done = 1;
+      input.tokens = tokens.size();
+      tokens.push_back(Token(TokenKind::Eof, "", 0));
+
+      start = Clock::now();
+      Parser parser(tokens, &lexer.line_index());
+      std::unique_ptr<BlockStmtAST> ast = parser.parse_program();
+      elapsed[kParse] += seconds_since(start);
+      done = 2;
+
+      start = Clock::now();
+      SemanticAnalyzer analyzer;
+      analyzer.setLineIndex(&lexer.line_index());
+      const bool ok = analyzer.analyze(ast.get());
+      elapsed[kSemantic] += seconds_since(start);
+      done = 3;
+      if (!ok) return done;
+
+      start = Clock::now();
+      std::string ir = IRGen::generate_ir_text(ast.get(), analyzer);
+      elapsed[kIRGen] += seconds_since(start);
+      done = 4;
+    } catch (const std::exception &) {
+      // 失败阶段的耗时不计入，与预热时记录的 reached 一致
+    }
+    return done;
+  }
+
+  void run_suite(Suite &suite, int warmup, int runs) {
+    for (int round = 0; round < warmup + runs; ++round) {
+      double elapsed[kPhaseCount] = {};
+      size_t reached[kPhaseCount] = {};
+      for (auto &input: suite.inputs) {
+        const int done = run_pipeline(input, elapsed);
+        for (int p = 0; p < done; ++p) ++reached[p];
+      }
+      if (round == 0) {
+        suite.tokens = 0;
+        for (const auto &input: suite.inputs) suite.tokens += input.tokens;
+        std::copy(std::begin(reached), std::end(reached), suite.reached);
+      }
+      if (round < warmup) continue;
+      for (int p = 0; p < kPhaseCount; ++p) suite.samples[p].push_back(elapsed[p]);
+    }
+  }
+
+  fs::path find_corpus_root(const char *argv0) {
+    const fs::path exe_dir = fs::absolute(argv0).parent_path();
+    for (const fs::path &candidate: {fs::current_path() / "test_case", exe_dir / "test_case",
+                                     exe_dir.parent_path() / "test_case"}) {
+      std::error_code ec;
+      if (fs::is_directory(candidate, ec)) return candidate;
+    }
+    return {};
+  }
+
+  // 语料按顶层子目录（IR-1、semantic-1 ...）分成套件
+  void collect_corpus(const fs::path &root, const std::vector<std::string> &filters, std::vector<Suite> &suites) {
+    std::map<std::string, std::vector<fs::path> > groups;
+    std::error_code ec;
+    for (const auto &entry: fs::recursive_directory_iterator(root, ec)) {
+      if (!entry.is_regular_file() || entry.path().extension() != ".rx") continue;
+      const std::string path = entry.path().string();
+      if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string &f) {
+        return path.find(f) != std::string::npos;
+      })) {
+        continue;
+      }
+      const fs::path rel = entry.path().lexically_relative(root);
+      groups[rel.begin()->string()].push_back(entry.path());
+    }
+    for (auto &[group, files]: groups) {
+      std::sort(files.begin(), files.end());
+      Suite suite;
+      suite.name = group;
+      for (const auto &file: files) {
+        Input input;
+        input.name = file.stem().string();
+        BenchUtil::read_file(file.string(), input.source);
+        suite.bytes += input.source.size();
+        suite.inputs.push_back(std::move(input));
+      }
+      suites.push_back(std::move(suite));
+    }
+  }
+
+  // 合成程序：functions 个形状相同的函数，涵盖数组、循环、结构体方法和函数调用，最后由 main 调用
+  std::string synthesize_program(int functions) {
+    std::ostringstream out;
+    out << "struct Acc {\n    sum: i32,\n    cnt: i32,\n}\n";
+    out << "impl Acc {\n    fn add(&mut self, v: i32) {\n        self.sum = self.sum + v;\n"
+           "        self.cnt += 1;\n    }\n}\n";
+    for (int i = 0; i < functions; ++i) {
+      out << "fn f" << i << "(a: i32, b: i32) -> i32 {\n"
+          << "    let mut arr: [i32; 16] = [0; 16];\n"
+          << "    let mut acc: Acc = Acc { sum: 0, cnt: 0 };\n"
+          << "    let mut k: i32 = 0;\n"
+          << "    while (k < 16) {\n"
+          << "        arr[k as usize] = a * k + b - " << i << ";\n"
+          << "        acc.add(arr[k as usize]);\n"
+          << "        k += 1;\n"
+          << "    }\n"
+          << "    if (acc.sum > " << i << ") {\n";
+      if (i > 0) {
+        out << "        return acc.sum % 1000 + f" << i - 1 << "(a, b - 1);\n";
+      } else {
+        out << "        return acc.sum % 1000;\n";
+      }
+      out << "    }\n"
+          << "    arr[5] - arr[1]\n"
+          << "}\n";
+    }
+    out << "fn main() {\n    let mut s: i32 = 0;\n";
+    if (functions > 0) out << "    s = s + f" << functions - 1 << "(1, 2);\n";
+    out << "    printlnInt(s);\n    exit(0);\n}\n";
+    return out.str();
+  }
+
+  void report_suite(const Suite &suite, int runs) {
+    std::cout << "[" << suite.name << "] " << suite.inputs.size() << " files, " << suite.bytes << " bytes, "
+              << suite.tokens << " tokens, " << runs << " runs\n";
+    std::cout << std::setw(10) << "phase" << std::setw(8) << "files" << std::setw(13) << "median(ms)" << std::setw(11)
+              << "p90(ms)" << std::setw(11) << "min(ms)" << std::setw(10) << "MB/s" << std::setw(11) << "Mtok/s\n";
+    std::cout << std::fixed << std::setprecision(3);
+    double total = 0;
+    for (int p = 0; p < kPhaseCount; ++p) {
+      const BenchUtil::Stats s = BenchUtil::summarize(suite.samples[p]);
+      total += s.median;
+      // 吞吐按该套件全部源码计算，便于各阶段直接比较
+      const double mbps = s.median > 0 ? static_cast<double>(suite.bytes) / s.median / 1e6 : 0;
+      const double mtps = s.median > 0 ? static_cast<double>(suite.tokens) / s.median / 1e6 : 0;
+      std::cout << std::setw(10) << kPhaseNames[p] << std::setw(8) << suite.reached[p] << std::setw(13)
+                << s.median * 1e3 << std::setw(11) << s.p90 * 1e3 << std::setw(11) << s.min * 1e3 << std::setw(10)
+                << mbps << std::setw(10) << mtps << "\n";
+    }
+    std::cout << std::setw(10) << "total" << std::setw(8) << "" << std::setw(13) << total * 1e3 << std::setw(11) << ""
+              << std::setw(11) << "" << std::setw(10)
+              << (total > 0 ? static_cast<double>(suite.bytes) / total / 1e6 : 0) << std::setw(10)
+              << (total > 0 ? static_cast<double>(suite.tokens) / total / 1e6 : 0) << "\n\n";
+    std::cout.unsetf(std::ios::floatfield);
+  }
+
+  bool write_baseline(const std::string &path, const std::vector<Suite> &suites, int runs) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    out << std::setprecision(6) << "{\n  \"version\": 1,\n  \"runs\": " << runs << ",\n  \"suites\": {";
+    for (size_t i = 0; i < suites.size(); ++i) {
+      const Suite &suite = suites[i];
+      out << (i ? ",\n" : "\n") << "    " << BenchUtil::json_quote(suite.name) << ": {\"bytes\": " << suite.bytes
+          << ", \"tokens\": " << suite.tokens;
+      for (int p = 0; p < kPhaseCount; ++p) {
+        const BenchUtil::Stats s = BenchUtil::summarize(suite.samples[p]);
+        out << ",\n      \"" << kPhaseNames[p] << "\": {\"median_ms\": " << s.median * 1e3 << ", \"p90_ms\": "
+            << s.p90 * 1e3 << "}";
+      }
+      out << "}";
+    }
+    out << "\n  }\n}\n";
+    return static_cast<bool>(out);
+  }
+
+  /**
+   * 逐阶段比较中位数；基线里没有的套件或阶段只提示不判定
+   * @return 是否存在超过阈值的回归
+   */
+  bool compare_baseline(const BenchUtil::JsonValue &baseline, const std::vector<Suite> &suites, double threshold) {
+    const BenchUtil::JsonValue *saved = baseline.get("suites");
+    if (!saved || !saved->isObject) throw std::runtime_error("baseline JSON: missing \"suites\"");
+    bool regressed = false;
+    std::cout << "Baseline comparison (threshold " << threshold * 100 << "%)\n";
+    std::cout << std::fixed << std::setprecision(3);
+    for (const Suite &suite: suites) {
+      const BenchUtil::JsonValue *old = saved->get(suite.name);
+      if (!old) {
+        std::cout << "  [" << suite.name << "] not in baseline\n";
+        continue;
+      }
+      const BenchUtil::JsonValue *oldBytes = old->get("bytes");
+      if (oldBytes && static_cast<size_t>(oldBytes->number) != suite.bytes) {
+        std::cout << "  [" << suite.name << "] input changed since baseline (" << static_cast<size_t>(oldBytes->number)
+                  << " -> " << suite.bytes << " bytes)\n";
+      }
+      for (int p = 0; p < kPhaseCount; ++p) {
+        const BenchUtil::JsonValue *phase = old->get(kPhaseNames[p]);
+        const BenchUtil::JsonValue *median = phase ? phase->get("median_ms") : nullptr;
+        if (!median || median->number <= 0) continue;
+        const double now = BenchUtil::summarize(suite.samples[p]).median * 1e3;
+        const double change = now / median->number - 1.0;
+        const bool bad = change > threshold;
+        regressed = regressed || bad;
+        std::cout << "  " << std::left << std::setw(12) << suite.name << std::setw(10) << kPhaseNames[p] << std::right
+                  << std::setw(11) << median->number << " ->" << std::setw(11) << now << " ms" << std::setw(9)
+                  << std::showpos << change * 100 << "%" << std::noshowpos << (bad ? "  REGRESSION" : "") << "\n";
+      }
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << (regressed ? "Regressions found" : "No regressions") << "\n";
+    return regressed;
+  }
+
+  std::vector<int> parse_scales(const std::string &list) {
+    std::vector<int> scales;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      const int n = std::stoi(item);
+      if (n > 0) scales.push_back(n);
+    }
+    return scales;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int runs = 5;
+  int warmup = 1;
+  std::vector<int> scales = {100, 1000};
+  std::string corpusArg;
+  std::string baselinePath;
+  std::string writeBaselinePath;
+  double threshold = 0.10;
+  std::vector<std::string> filters;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg(argv[i]);
+      if (arg.rfind("--runs=", 0) == 0) {
+        runs = std::max(1, std::stoi(arg.substr(7)));
+      } else if (arg.rfind("--warmup=", 0) == 0) {
+        warmup = std::max(0, std::stoi(arg.substr(9)));
+      } else if (arg.rfind("--scale=", 0) == 0) {
+        scales = parse_scales(arg.substr(8));
+      } else if (arg.rfind("--corpus=", 0) == 0) {
+        corpusArg = arg.substr(9);
+      } else if (arg.rfind("--baseline=", 0) == 0) {
+        baselinePath = arg.substr(11);
+      } else if (arg.rfind("--threshold=", 0) == 0) {
+        threshold = std::stod(arg.substr(12));
+      } else if (arg.rfind("--write-baseline=", 0) == 0) {
+        writeBaselinePath = arg.substr(17);
+      } else if (arg.rfind("--", 0) == 0) {
+        std::cerr << "Unknown option: " << arg << std::endl;
+        return 2;
+      } else {
+        filters.push_back(arg);
+      }
+    }
+  } catch (const std::exception &) {
+    std::cerr << "Invalid option value" << std::endl;
+    return 2;
+  }
+  // 先解析基线，免得跑完才发现文件有误
+  BenchUtil::JsonValue baseline;
+  if (!baselinePath.empty()) {
+    std::string text;
+    if (!BenchUtil::read_file(baselinePath, text)) {
+      std::cerr << "Cannot open baseline: " << baselinePath << std::endl;
+      return 2;
+    }
+    try {
+      baseline = BenchUtil::parse_json(text);
+    } catch (const std::exception &ex) {
+      std::cerr << ex.what() << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<Suite> suites;
+  const fs::path corpus = corpusArg.empty() ? find_corpus_root(argv[0]) : fs::path(corpusArg);
+  if (corpus.empty()) {
+    std::cout << "No test_case directory found (checked relative to cwd and exe dir); running synthetic inputs only\n";
+  } else {
+    collect_corpus(corpus, filters, suites);
+  }
+  for (int n: scales) {
+    Suite suite;
+    suite.name = "synth-" + std::to_string(n);
+    Input input;
+    input.name = suite.name;
+    input.source = synthesize_program(n);
+    suite.bytes = input.source.size();
+    suite.inputs.push_back(std::move(input));
+    suites.push_back(std::move(suite));
+  }
+  if (suites.empty()) {
+    std::cerr << "Nothing to benchmark" << std::endl;
+    return 2;
+  }
+
+  // 语料里预期失败的程序会在每一轮打印诊断，计时期间关掉标准错误
+  for (Suite &suite: suites) {
+    std::streambuf *saved = std::cerr.rdbuf(nullptr);
+    run_suite(suite, warmup, runs);
+    std::cerr.rdbuf(saved);
+    report_suite(suite, runs);
+  }
+
+  if (!writeBaselinePath.empty()) {
+    if (!write_baseline(writeBaselinePath, suites, runs)) {
+      std::cerr << "Cannot write baseline: " << writeBaselinePath << std::endl;
+      return 2;
+    }
+    std::cout << "Wrote baseline: " << writeBaselinePath << "\n";
+  }
+  if (!baselinePath.empty() && compare_baseline(baseline, suites, threshold)) {
+    return 1;
+  }
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include <algorithm>
 #include <iostream>
 #include <regex>
 #include <boost/regex.hpp>
@@ -82,7 +83,7 @@ static const std::vector<LexRule> lex_rules = {
 }; //正则表达式多为GPT生成
 
 
-Lexer::Lexer(const std::string &src) : src_(src), pos_(0) {
+Lexer::Lexer(std::string_view src) : src_(src), pos_(0), lines_(src_) {
   currentChar = src_.empty() ? EOF : src_[0];
 }
 
@@ -91,10 +92,10 @@ void Lexer::advance() {
   currentChar = pos_ < src_.size() ? src_[pos_] : EOF;
 }
 
-bool Lexer::match(const boost::regex &re, const std::string &src, size_t &pos, std::string &matched) {
-  boost::smatch m;
-  std::string cur = src.substr(pos);
-  if (boost::regex_search(cur, m, re) && m.position() == 0) {
+bool Lexer::match(const boost::regex &re, std::string_view src, size_t &pos, std::string &matched) {
+  // 直接在源代码上从 pos 处锚定匹配，不为每次尝试复制剩余源码
+  boost::cmatch m;
+  if (boost::regex_search(src.data() + pos, src.data() + src.size(), m, re, boost::match_continuous)) {
     matched = m.str();
     pos += matched.length();
     currentChar = pos < src_.size() ? src_[pos] : EOF;
@@ -196,17 +197,26 @@ Token Lexer::next_token() {
   return Token(TokenKind::Unknown, "Invalid", pos_ - 1);
 }
 
-std::pair<int, int> Lexer::getLineAndCol(int p) {
-  int line = 1, col = 1;
-  for (int i = 0; i < p; ++i) {
-    if (src_[i] == '\n') {
-      ++line;
-      col = 1;
-    } else {
-      ++col;
-    }
+LineIndex::LineIndex(std::string_view src) {
+  for (size_t i = src.find('\n'); i != std::string_view::npos; i = src.find('\n', i + 1)) {
+    lineStarts_.push_back(i + 1);
   }
-  return {line, col};
+}
+
+std::pair<int, int> LineIndex::lookup(size_t pos) const {
+  // 最后一个不大于 pos 的行首即为所在行
+  auto it = std::upper_bound(lineStarts_.begin(), lineStarts_.end(), pos);
+  size_t line = static_cast<size_t>(it - lineStarts_.begin());
+  return {static_cast<int>(line), static_cast<int>(pos - lineStarts_[line - 1] + 1)};
+}
+
+std::string LineIndex::describe(size_t pos) const {
+  auto [line, col] = lookup(pos);
+  return "line " + std::to_string(line) + ", column " + std::to_string(col);
+}
+
+std::pair<int, int> Lexer::getLineAndCol(int p) {
+  return lines_.lookup(p < 0 ? 0 : static_cast<size_t>(p));
 }
 
 bool Lexer::is_eof() const {
@@ -0,0 +1,49 @@
+#include "mappedfile.h"
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+  release();
+}
+
+void MappedFile::release() {
+#ifndef _WIN32
+  if (mapped_) ::munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  std::string().swap(buffer_);
+}
+
+bool MappedFile::open(const std::string &path) {
+  release();
+#ifndef _WIN32
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st{};
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      data_ = static_cast<const unsigned char *>(addr);
+      size_ = static_cast<size_t>(st.st_size);
+      mapped_ = true;
+    }
+  }
+  ::close(fd);
+  if (mapped_) return true;
+#endif
+  // 空文件、管道等无法映射的输入：整个读进缓冲区
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  data_ = reinterpret_cast<const unsigned char *>(buffer_.data());
+  size_ = buffer_.size();
+  return true;
+}
@@ -0,0 +1,241 @@
+#include "memtrack.h"
+#include "timetrace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace MemTrack {
+  namespace {
+    // 以阶段名指针为键的固定大小开放寻址表：统计路径本身不能再分配内存
+    constexpr size_t kSlots = 128;
+
+    struct PhaseStats {
+      std::atomic<const char *> name{nullptr};
+      std::atomic<uint64_t> order{0}; // 首次分配的先后，报告按此排列
+      std::atomic<uint64_t> allocs{0};
+      std::atomic<uint64_t> bytes{0};
+      std::atomic<int64_t> peakLive{0};
+      std::atomic<int64_t> rssKb{0};
+    };
+
+    PhaseStats g_phases[kSlots];
+    std::atomic<uint64_t> g_nextOrder{0};
+    // 启用以来的存活字节；启用前分配、启用后释放的块会让它略微偏低
+    std::atomic<int64_t> g_live{0};
+    std::atomic<int64_t> g_peakLive{0};
+    bool g_enabled = false; // 只在启动工作线程之前设置，之后只读
+
+    constexpr const char *kNoPhase = "(no phase)";
+
+    PhaseStats *statsFor(const char *name) {
+      const size_t start = (reinterpret_cast<uintptr_t>(name) >> 3) % kSlots;
+      for (size_t i = 0; i < kSlots; ++i) {
+        PhaseStats &s = g_phases[(start + i) % kSlots];
+        const char *current = s.name.load(std::memory_order_acquire);
+        if (!current && s.name.compare_exchange_strong(current, name, std::memory_order_acq_rel)) {
+          s.order.store(g_nextOrder.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+          return &s;
+        }
+        if (current == name) return &s;
+      }
+      return nullptr; // 表满：新阶段不再统计
+    }
+
+    void raise(std::atomic<int64_t> &peak, int64_t value) {
+      int64_t seen = peak.load(std::memory_order_relaxed);
+      while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+      }
+    }
+
+    // 按实际块大小记存活字节，分配与释放两侧一致
+    int64_t blockSize(void *p) {
+#if defined(__GLIBC__)
+      return static_cast<int64_t>(malloc_usable_size(p));
+#elif defined(__APPLE__)
+      return static_cast<int64_t>(malloc_size(p));
+#else
+      (void) p;
+      return 0; // 无法得知块大小：不跟踪存活字节
+#endif
+    }
+
+    int64_t peakRssKb() {
+#ifndef _WIN32
+      struct rusage usage{};
+      if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+      return usage.ru_maxrss / 1024; // macOS 以字节为单位
+#else
+      return usage.ru_maxrss;
+#endif
+#else
+      return 0;
+#endif
+    }
+
+    void onAlloc(void *p, size_t size) {
+      const char *phase = TimeTrace::currentPhase();
+      const int64_t block = blockSize(p);
+      const int64_t live = g_live.fetch_add(block, std::memory_order_relaxed) + block;
+      raise(g_peakLive, live);
+      PhaseStats *s = statsFor(phase ? phase : kNoPhase);
+      if (!s) return;
+      s->allocs.fetch_add(1, std::memory_order_relaxed);
+      s->bytes.fetch_add(size, std::memory_order_relaxed);
+      raise(s->peakLive, live);
+    }
+
+    void onFree(void *p) {
+      g_live.fetch_sub(blockSize(p), std::memory_order_relaxed);
+    }
+
+    void onPhaseEnd(const char *name) {
+      if (PhaseStats *s = statsFor(name)) raise(s->rssKb, peakRssKb());
+    }
+
+    void *allocate(size_t size) {
+      if (size == 0) size = 1;
+      void *p;
+      while (!(p = std::malloc(size))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+      }
+      if (g_enabled) onAlloc(p, size);
+      return p;
+    }
+
+    void deallocate(void *p) noexcept {
+      if (!p) return;
+      if (g_enabled) onFree(p);
+      std::free(p);
+    }
+
+    double toKb(int64_t bytes) {
+      return static_cast<double>(bytes) / 1024.0;
+    }
+  }
+
+  void enable() {
+    g_enabled = true;
+    TimeTrace::enable(false);
+    TimeTrace::setPhaseEndHook(onPhaseEnd);
+  }
+
+  bool enabled() {
+    return g_enabled;
+  }
+
+  void printReport(std::ostream &out) {
+    struct Row {
+      std::string_view name;
+      uint64_t order;
+      uint64_t allocs;
+      int64_t bytes;
+      int64_t peakLive;
+      int64_t rssKb;
+    };
+    // 先取快照并暂停统计，报告自身的分配不计入
+    const bool wasEnabled = g_enabled;
+    g_enabled = false;
+    std::vector<Row> rows;
+    for (const PhaseStats &s: g_phases) {
+      const char *name = s.name.load(std::memory_order_acquire);
+      if (!name) continue;
+      Row row{name, s.order.load(), s.allocs.load(), static_cast<int64_t>(s.bytes.load()), s.peakLive.load(),
+              s.rssKb.load()};
+      // 同名字面量在不同编译单元中可能是不同指针，按名字合并
+      auto it = std::find_if(rows.begin(), rows.end(), [&](const Row &r) { return r.name == row.name; });
+      if (it == rows.end()) {
+        rows.push_back(row);
+        continue;
+      }
+      it->order = std::min(it->order, row.order);
+      it->allocs += row.allocs;
+      it->bytes += row.bytes;
+      it->peakLive = std::max(it->peakLive, row.peakLive);
+      it->rssKb = std::max(it->rssKb, row.rssKb);
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return a.order < b.order; });
+
+    uint64_t totalAllocs = 0;
+    int64_t totalBytes = 0;
+    for (const Row &row: rows) {
+      totalAllocs += row.allocs;
+      totalBytes += row.bytes;
+    }
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << "===----------------------------------------------------------===\n";
+    out << "                       Memory report\n";
+    out << "===----------------------------------------------------------===\n";
+    out << "  Peak RSS: " << peakRssKb() << " KB, peak live heap: " << toKb(g_peakLive.load()) << " KB\n";
+    out << "  Total: " << totalAllocs << " allocations, " << toKb(totalBytes) << " KB\n";
+    out << "  (allocations go to the innermost phase; PeakLive is the heap high-water mark while\n"
+           "   the phase ran; RSS is the process peak RSS when the phase last ended)\n\n";
+    out << std::setw(11) << "Allocs" << std::setw(13) << "Alloc(KB)" << std::setw(14) << "PeakLive(KB)"
+        << std::setw(10) << "RSS(KB)" << "  Name\n";
+    for (const Row &row: rows) {
+      out << std::setw(11) << row.allocs << std::setw(13) << toKb(row.bytes) << std::setw(14) << toKb(row.peakLive)
+          << std::setw(10);
+      if (row.rssKb > 0) {
+        out << row.rssKb;
+      } else {
+        out << "-";
+      }
+      out << "  " << row.name << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+    g_enabled = wasEnabled;
+  }
+
+  Session::Session(bool report) : report_(report) {
+    if (report_) enable();
+  }
+
+  Session::~Session() {
+    if (report_) printReport(std::cerr);
+  }
+}
+
+// 全局分配函数的替换；nothrow 版本由标准库转发到这里
+void *operator new(std::size_t size) {
+  return MemTrack::allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return MemTrack::allocate(size);
+}
+
+void operator delete(void *p) noexcept {
+  MemTrack::deallocate(p);
+}
+
+void operator delete[](void *p) noexcept {
+  MemTrack::deallocate(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  MemTrack::deallocate(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  MemTrack::deallocate(p);
+}
@@ -3,10 +3,11 @@
 #include <array>
 #include <cstdint>
 #include <memory>
+#include <string_view>
 
 namespace {
 
-int64_t parseIntegerLiteralToken(const std::string& text, size_t position) {
+int64_t parseIntegerLiteralToken(const std::string& text, size_t position, const Parser& parser) {
   static const std::array<std::string, 4> suffixes = {"i32", "u32", "isize", "usize"};
 
   std::string cleaned = text;
@@ -20,7 +21,7 @@ int64_t parseIntegerLiteralToken(const std::string& text, size_t position) {
 
   cleaned.erase(std::remove(cleaned.begin(), cleaned.end(), '_'), cleaned.end());
   if (cleaned.empty()) {
-    std::cerr << "Invalid numeric literal '" << text << "' at position " << position << std::endl;
+    std::cerr << "Invalid numeric literal '" << text << "' at " << parser.where(position) << std::endl;
     throw std::runtime_error("Invalid numeric literal");
   }
 
@@ -28,12 +29,12 @@ int64_t parseIntegerLiteralToken(const std::string& text, size_t position) {
     size_t consumed = 0;
     int64_t value = std::stoll(cleaned, &consumed, 0);
     if (consumed != cleaned.size()) {
-      std::cerr << "Invalid numeric literal '" << text << "' at position " << position << std::endl;
+      std::cerr << "Invalid numeric literal '" << text << "' at " << parser.where(position) << std::endl;
       throw std::runtime_error("Invalid numeric literal");
     }
     return value;
   } catch (const std::exception& ex) {
-    std::cerr << "Invalid numeric literal '" << text << "' at position " << position
+    std::cerr << "Invalid numeric literal '" << text << "' at " << parser.where(position)
               << "': " << ex.what() << std::endl;
     throw std::runtime_error("Invalid numeric literal");
   }
@@ -192,12 +193,26 @@ static std::unique_ptr<IfExprAST> try_convert_if_to_expr(IfStmtAST* if_stmt) {
 }
 
 //入口
+uint64_t Parser::hash_tokens(size_t begin, size_t end) const {
+  // FNV-1a；记号之间插入种类作分隔，"a b" 与 "ab" 不会混淆
+  uint64_t hash = 1469598103934665603ull;
+  auto mix = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  };
+  for (size_t i = begin; i < end && i < tokens.size(); ++i) {
+    mix(static_cast<unsigned char>(tokens[i].kind()) + 1);
+    for (char c: tokens[i].text()) mix(static_cast<unsigned char>(c));
+  }
+  return hash;
+}
+
 std::unique_ptr<BlockStmtAST> Parser::parse_program() {
   std::vector<std::unique_ptr<StmtAST> > stmts;
   while (!match(TokenKind::Eof)) {
     auto stmt = parse_stmt();
     if (!stmt) {
-      std::cerr << "Invalid statement at position " << current().position() << std::endl;
+      std::cerr << "Invalid statement at " << where(current().position()) << std::endl;
       throw std::runtime_error("Invalid statement");
     }
     stmts.push_back(std::move(stmt));
@@ -205,76 +220,64 @@ std::unique_ptr<BlockStmtAST> Parser::parse_program() {
   return std::make_unique<BlockStmtAST>(std::move(stmts), 0);
 }
 
-//parse逻辑表达式
-std::unique_ptr<ExprAST> Parser::parse_logical() {
-  auto lhs = parse_equality();
-  while (match(TokenKind::Operator, "&&") || match(TokenKind::Operator, "||")) {
-    std::string op = current().text();
-    size_t pos_ = current().position();
-    advance();
-    auto rhs = parse_equality();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
-  }
-  return lhs;
-}
-
-std::unique_ptr<ExprAST> Parser::parse_bitwise() {
-  auto lhs = parse_comparison();
-  while (match(TokenKind::Operator, "&") || match(TokenKind::Operator, "^") || match(TokenKind::Operator, "|")) {
-    std::string op = current().text();
-    size_t pos_ = current().position();
-    advance();
-    auto rhs = parse_comparison();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
-  }
-  return lhs;
-}
-
-std::unique_ptr<ExprAST> Parser::parse_equality() {
-  auto lhs = parse_bitwise();
-  while (match(TokenKind::Comparison, "==") || match(TokenKind::Comparison, "!=")) {
-    std::string op = current().text();
-    size_t pos_ = current().position();
-    advance();
-    auto rhs = parse_bitwise();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
-  }
-  return lhs;
-}
-
-//parse比较表达式
-std::unique_ptr<ExprAST> Parser::parse_comparison() {
-  auto lhs = parse_shift();
-  while (match(TokenKind::Comparison, "<") || match(TokenKind::Comparison, "<=") ||
-         match(TokenKind::Comparison, ">") || match(TokenKind::Comparison, ">=")) {
-    std::string op = current().text();
-    size_t pos_ = current().position();
-    advance();
-    auto rhs = parse_shift();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
+// 二元运算符优先级表：数值越大结合越紧，全部左结合
+// 由低到高：逻辑 < 相等 < 位运算 < 比较 < 移位 < 加减 < 乘除模
+namespace {
+struct BinaryOpInfo {
+  TokenKind kind;
+  std::string_view text;
+  int precedence;
+  bool right_assoc;
+};
+
+constexpr BinaryOpInfo kBinaryOps[] = {
+  {TokenKind::Operator, "&&", 1, false},
+  {TokenKind::Operator, "||", 1, false},
+  {TokenKind::Comparison, "==", 2, false},
+  {TokenKind::Comparison, "!=", 2, false},
+  {TokenKind::Operator, "&", 3, false},
+  {TokenKind::Operator, "^", 3, false},
+  {TokenKind::Operator, "|", 3, false},
+  {TokenKind::Comparison, "<", 4, false},
+  {TokenKind::Comparison, "<=", 4, false},
+  {TokenKind::Comparison, ">", 4, false},
+  {TokenKind::Comparison, ">=", 4, false},
+  {TokenKind::Operator, "<<", 5, false},
+  {TokenKind::Operator, ">>", 5, false},
+  {TokenKind::Operator, "+", 6, false},
+  {TokenKind::Operator, "-", 6, false},
+  {TokenKind::Operator, "*", 7, false},
+  {TokenKind::Operator, "/", 7, false},
+  {TokenKind::Operator, "%", 7, false},
+};
+
+constexpr int kLowestBinaryPrecedence = 1;
+
+// 查表得到当前记号的二元运算符信息，不是二元运算符时返回nullptr
+const BinaryOpInfo *lookup_binary_op(const Token &tok) {
+  const TokenKind kind = tok.kind();
+  if (kind != TokenKind::Operator && kind != TokenKind::Comparison) return nullptr;
+  const std::string &text = tok.text();
+  for (const auto &info : kBinaryOps) {
+    if (info.kind == kind && info.text == text) return &info;
   }
-  return lhs;
+  return nullptr;
 }
+} // namespace
 
-std::unique_ptr<ExprAST> Parser::parse_shift() {
-  auto lhs = parse_additive();
-  while (match(TokenKind::Operator, "<<") || match(TokenKind::Operator, ">>")) {
-    std::string op = current().text();
-    size_t pos_ = current().position();
-    advance();
-    auto rhs = parse_additive();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
-  }
-  return lhs;
+//parse二元运算（优先级爬升）：只吸收优先级不低于min_prec的运算符
+std::unique_ptr<ExprAST> Parser::parse_binary(int min_prec) {
+  return parse_binary_rhs(min_prec, parse_cast_expr());
 }
 
-std::unique_ptr<ExprAST> Parser::parse_additive() {
-  auto lhs = parse_term();
-  while (match(TokenKind::Operator, "+") || match(TokenKind::Operator, "-")) {
+// 以已解析好的lhs作为左操作数继续吸收二元运算符
+std::unique_ptr<ExprAST> Parser::parse_binary_rhs(int min_prec, std::unique_ptr<ExprAST> lhs) {
+  while (const BinaryOpInfo *info = lookup_binary_op(current())) {
+    if (info->precedence < min_prec) break;
     std::string op = current().text();
-    size_t pos_ = current().position();
+    size_t pos_ = current().position(); // 记录运算符位置
     advance();
-    auto rhs = parse_term();
+    auto rhs = parse_binary(info->right_assoc ? info->precedence : info->precedence + 1);
     lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
   }
   return lhs;
@@ -311,7 +314,7 @@ std::unique_ptr<ExprAST> Parser::parse_block_expr() {
     return block_expr;
   } else {
     // 转换失败，无法作为表达式返回
-    std::cerr << "Expected expression or return statement as last statement in block at position " << pos_ << std::endl;
+    std::cerr << "Expected expression or return statement as last statement in block at " << where(pos_) << std::endl;
     throw std::runtime_error("Expected expression or return statement as last statement in block");
   }
 }
@@ -339,7 +342,7 @@ std::unique_ptr<ExprAST> Parser::parse_if_expr() {
       then_branch = std::move(block_expr);
     } else {
       // 转换失败，无法作为表达式返回
-      std::cerr << "Expected expression or return statement as last statement in if block at position " << pos_ << std::endl;
+      std::cerr << "Expected expression or return statement as last statement in if block at " << where(pos_) << std::endl;
       throw std::runtime_error("Expected expression or return statement as last statement in if block");
     }
   } else {
@@ -362,7 +365,7 @@ std::unique_ptr<ExprAST> Parser::parse_if_expr() {
       else_branch = std::move(block_expr);
     } else {
       // 转换失败，无法作为表达式返回
-      std::cerr << "Expected expression or return statement as last statement in else block at position " << pos_ << std::endl;
+      std::cerr << "Expected expression or return statement as last statement in else block at " << where(pos_) << std::endl;
       throw std::runtime_error("Expected expression or return statement as last statement in else block");
     }
   } else if (match(TokenKind::Keyword, "if")) {
@@ -381,7 +384,12 @@ std::unique_ptr<ExprAST> Parser::parse_if_expr() {
 
 //parse一个低级优先运算
 std::unique_ptr<ExprAST> Parser::parse_expr() {
-  auto lhs = parse_logical();
+  return parse_expr_rest(parse_cast_expr());
+}
+
+// 以已解析好的首个操作数继续解析完整表达式
+std::unique_ptr<ExprAST> Parser::parse_expr_rest(std::unique_ptr<ExprAST> lhs) {
+  lhs = parse_binary_rhs(kLowestBinaryPrecedence, std::move(lhs));
   while (match(TokenKind::Keyword, "as")) {
     advance();
     auto type_ast = parse_type();
@@ -391,19 +399,6 @@ std::unique_ptr<ExprAST> Parser::parse_expr() {
   return lhs;
 }
 
-//parse一个中优先级运算
-std::unique_ptr<ExprAST> Parser::parse_term() {
-  auto lhs = parse_cast_expr();
-  while (match(TokenKind::Operator, "*") || match(TokenKind::Operator, "/") || match(TokenKind::Operator, "%")) {
-    std::string op = current().text();
-    size_t pos_ = current().position(); // 记录运算符位置
-    advance();
-    auto rhs = parse_cast_expr();
-    lhs = std::make_unique<BinaryExprAST>(op, pos_, std::move(lhs), std::move(rhs));
-  }
-  return lhs;
-}
-
 std::unique_ptr<ExprAST> Parser::parse_cast_expr() {
   auto expr = parse_factor();
   while (match(TokenKind::Keyword, "as")) {
@@ -449,7 +444,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
   // 处理字面量
   if (match(TokenKind::Number)) {
     const std::string literal = current().text();
-    int64_t val = parseIntegerLiteralToken(literal, pos_);
+    int64_t val = parseIntegerLiteralToken(literal, pos_, *this);
     advance();
     
     // 特殊处理3.to_string()语法
@@ -465,7 +460,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
       }
       
       // 其他方法调用或字段访问，报错
-      std::cerr << "Method calls or field access on number literals are not supported at position " << pos_ << std::endl;
+      std::cerr << "Method calls or field access on number literals are not supported at " << where(pos_) << std::endl;
       throw std::runtime_error("Method calls or field access on number literals are not supported");
     }
     
@@ -518,7 +513,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
             } else if (match(TokenKind::Punctuation, ")")) {
               break;
             } else {
-              std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+              std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
               throw std::runtime_error("Expected ',' or ')' in function arguments");
             }
           }
@@ -572,7 +567,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
           advance();
           if (current().kind() != TokenKind::Identifier && 
               !(current().kind() == TokenKind::Keyword && current().text() == "self")) {
-            std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+            std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
             throw std::runtime_error("Expected identifier after '.'");
           }
           string member_name = current().text();
@@ -594,7 +589,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
                 } else if (match(TokenKind::Punctuation, ")")) {
                   break;
                 } else {
-                  std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+                  std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
                   throw std::runtime_error("Expected ',' or ')' in function arguments");
                 }
               }
@@ -633,7 +628,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
           } else if (match(TokenKind::Punctuation, ")")) {
             break;
           } else {
-            std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+            std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
             throw std::runtime_error("Expected ',' or ')' in function arguments");
           }
         }
@@ -658,7 +653,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
           advance();
           if (current().kind() != TokenKind::Identifier && 
               !(current().kind() == TokenKind::Keyword && current().text() == "self")) {
-            std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+            std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
             throw std::runtime_error("Expected identifier after '.'");
           }
           string member_name = current().text();
@@ -680,7 +675,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
                 } else if (match(TokenKind::Punctuation, ")")) {
                   break;
                 } else {
-                  std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+                  std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
                   throw std::runtime_error("Expected ',' or ')' in function arguments");
                 }
               }
@@ -721,7 +716,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
       if (match(TokenKind::Punctuation, ".")) {
         advance();
         if (current().kind() != TokenKind::Identifier) {
-          std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+          std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
           throw std::runtime_error("Expected identifier after '.'");
         }
         string member_name = current().text();
@@ -743,7 +738,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
               } else if (match(TokenKind::Punctuation, ")")) {
                 break;
               } else {
-                std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+                std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
                 throw std::runtime_error("Expected ',' or ')' in function arguments");
               }
             }
@@ -805,7 +800,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
       if (match(TokenKind::Punctuation, ".")) {
         advance();
         if (current().kind() != TokenKind::Identifier) {
-          std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+          std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
           throw std::runtime_error("Expected identifier after '.'");
         }
         string member_name = current().text();
@@ -868,7 +863,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
       if (match(TokenKind::Punctuation, ".")) {
         advance();
         if (current().kind() != TokenKind::Identifier) {
-          std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+          std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
           throw std::runtime_error("Expected identifier after '.'");
         }
         string member_name = current().text();
@@ -890,7 +885,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
               } else if (match(TokenKind::Punctuation, ")")) {
                 break;
               } else {
-                std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+                std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
                 throw std::runtime_error("Expected ',' or ')'");
               }
             }
@@ -951,7 +946,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
         advance();
         break;
       } else {
-        std::cerr << "Expected ',' or ']' in array elements at position " << current().position() << std::endl;
+        std::cerr << "Expected ',' or ']' in array elements at " << where(current().position()) << std::endl;
         throw std::runtime_error("Expected ',' or ']'");
       }
     }
@@ -959,7 +954,7 @@ std::unique_ptr<ExprAST> Parser::parse_factor() {
     return std::make_unique<ArrayExprAST>(std::move(elements), pos_);
   }
 
-  std::cerr << "Invalid factor: " << current().text() << " at position " << current().position() << std::endl;
+  std::cerr << "Invalid factor: " << current().text() << " at " << where(current().position()) << std::endl;
   throw std::runtime_error("Invalid factor");
 }
 
@@ -975,7 +970,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
   
   if (tok.kind() == TokenKind::Keyword) {
     if (tok.text() == "as") {
-      std::cerr << "Unexpected keyword: as at position " << current().position() << "\n";
+      std::cerr << "Unexpected keyword: as at " << where(current().position()) << "\n";
       throw std::runtime_error("Unexpected keyword: as");
     } else if (tok.text() == "break") {
       advance();
@@ -1002,6 +997,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
         return std::make_unique<BreakStmtAST>(tok.position());
       }
     } else if (tok.text() == "const") {
+      const size_t first = pos;
       advance();
       if (current().kind() == TokenKind::Keyword && current().text() == "fn") {
         advance();
@@ -1011,9 +1007,13 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
         auto ret_type = parse_fn_return_type();
         // 可解析返回类型、泛型等
         // 解析函数体
+        size_t types_before = type_decls;
         auto body = parse_block();
         // 返回 const 函数节点
-        return std::make_unique<FnStmtAST>(fn_name, std::move(params), std::move(ret_type), std::move(body), true, tok.position());
+        auto fn = std::make_unique<FnStmtAST>(fn_name, std::move(params), std::move(ret_type), std::move(body), true, tok.position());
+        fn->declares_local_types = type_decls != types_before;
+        fn->content_hash = hash_tokens(first, pos);
+        return fn;
       } else {
         // 否则是 const 常量
         std::string name = expect_identifier();
@@ -1029,13 +1029,13 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       expect(TokenKind::Punctuation, ";");
       return std::make_unique<ContinueStmtAST>(tok.position());
     } else if (tok.text() == "crate") {
-      std::cerr << "Keyword not supported: crate at position " << current().position();
+      std::cerr << "Keyword not supported: crate at " << where(current().position());
       throw std::runtime_error("Keyword not supported: crate");
     } else if (tok.text() == "dyn") {
-      std::cerr << "Keyword not supported: dyn at position " << current().position();
+      std::cerr << "Keyword not supported: dyn at " << where(current().position());
       throw std::runtime_error("Keyword not supported: dyn");
     } else if (tok.text() == "else") {
-      std::cerr << "Unexpected keyword: else (must be part of if statement) at position " << current().position();
+      std::cerr << "Unexpected keyword: else (must be part of if statement) at " << where(current().position());
       throw std::runtime_error("Unexpected keyword: else");
     } else if (tok.text() == "enum") {
       advance();
@@ -1061,6 +1061,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       }
 
       expect(TokenKind::Punctuation, "}");
+      ++type_decls;
       return std::make_unique<EnumStmtAST>(name, std::move(variants), tok.position());
     } else if (tok.text() == "exit") {
       advance();
@@ -1078,19 +1079,24 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       }
       return std::make_unique<ExitStmtAST>(tok.position(), std::move(exit_code));
     } else if (tok.text() == "fn") {
+      const size_t first = pos;
       advance();
       std::string fn_name = expect_identifier();
       expect(TokenKind::Punctuation, "(");
       auto params = parse_fn_params();
       auto ret_type = parse_fn_return_type();
       // 可解析返回类型、泛型等，解析函数体
+      size_t types_before = type_decls;
       auto body = parse_block();
       // 返回函数节点
-      return std::make_unique<FnStmtAST>(fn_name, std::move(params), std::move(ret_type), std::move(body), false, tok.position());
+      auto fn = std::make_unique<FnStmtAST>(fn_name, std::move(params), std::move(ret_type), std::move(body), false, tok.position());
+      fn->declares_local_types = type_decls != types_before;
+      fn->content_hash = hash_tokens(first, pos);
+      return fn;
     } else if (tok.text() == "for") {
       advance();
       // 解析for循环，这里简化处理
-      std::cerr << "Keyword not fully implemented: for at position " << current().position();
+      std::cerr << "Keyword not fully implemented: for at " << where(current().position());
       throw std::runtime_error("Keyword not fully implemented: for");
     } else if (tok.text() == "if") {
       advance();
@@ -1115,7 +1121,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       advance();
       return parse_impl();
     } else if (tok.text() == "in") {
-      std::cerr << "Keyword not supported: in at position " << current().position();
+      std::cerr << "Keyword not supported: in at " << where(current().position());
       throw std::runtime_error("Keyword not supported: in");
     } else if (tok.text() == "let") {
       advance();
@@ -1142,7 +1148,6 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       std::string name = expect_identifier();
 
       // 检查是否有类型注解
-      std::string type_name = "";
       unique_ptr<TypeAST> type_ast = nullptr;
       if (current().kind() == TokenKind::Punctuation && current().text() == ":") {
         advance();
@@ -1163,16 +1168,10 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
         advance();
         auto value = parse_expr();
         expect(TokenKind::Punctuation, ";");
-        return std::make_unique<LetStmtAST>(std::move(pattern), type_name, std::move(value), tok.position());
-      } else if (!type_name.empty()) {
-        // 有类型注解但没有初始值，如 let &x: i32;
-        expect(TokenKind::Punctuation, ";");
-        // 创建一个空的表达式作为值
-        std::unique_ptr<ExprAST> value = nullptr;
-        return std::make_unique<LetStmtAST>(std::move(pattern), type_name, std::move(value), tok.position());
+        return std::make_unique<LetStmtAST>(std::move(pattern), std::move(value), tok.position());
       } else {
-        // 既没有类型注解也没有初始值，这是错误的
-        std::cerr << "Expected '=' or ':' after identifier in let statement at position " << current().position();
+        // 没有初始值，这是错误的
+        std::cerr << "Expected '=' or ':' after identifier in let statement at " << where(current().position());
         throw std::runtime_error("Expected '=' or ':' after identifier in let statement");
       }
     } else if (tok.text() == "loop") {
@@ -1181,22 +1180,22 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       auto body = parse_stmt();
       return std::make_unique<LoopStmtAST>(std::move(body), tok.position());
     } else if (tok.text() == "match") {
-      std::cerr << "Keyword not supported: match at position " << current().position();
+      std::cerr << "Keyword not supported: match at " << where(current().position());
       throw std::runtime_error("Keyword not supported: match");
     } else if (tok.text() == "mod") {
-      std::cerr << "Keyword not supported: mod at position " << current().position();
+      std::cerr << "Keyword not supported: mod at " << where(current().position());
       throw std::runtime_error("Keyword not supported: mod");
     } else if (tok.text() == "move") {
-      std::cerr << "Keyword not supported: move at position " << current().position();
+      std::cerr << "Keyword not supported: move at " << where(current().position());
       throw std::runtime_error("Keyword not supported: move");
     } else if (tok.text() == "mut") {
-      std::cerr << "Keyword not supported: mut at position " << current().position();
+      std::cerr << "Keyword not supported: mut at " << where(current().position());
       throw std::runtime_error("Keyword not supported: mut");
     } else if (tok.text() == "pub") {
-      std::cerr << "Keyword not supported: pub at position " << current().position();
+      std::cerr << "Keyword not supported: pub at " << where(current().position());
       throw std::runtime_error("Keyword not supported: pub");
     } else if (tok.text() == "ref") {
-      std::cerr << "Keyword not supported: ref at position " << current().position();
+      std::cerr << "Keyword not supported: ref at " << where(current().position());
       throw std::runtime_error("Keyword not supported: ref");
     } else if (tok.text() == "return") {
       advance();
@@ -1223,12 +1222,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       auto lhs_expr = parse_value();
       
       // 检查是否是赋值语句
-      if (match(TokenKind::Operator, "=") || match(TokenKind::Operator, "+=") ||
-          match(TokenKind::Operator, "-=") || match(TokenKind::Operator, "*=") ||
-          match(TokenKind::Operator, "/=") || match(TokenKind::Operator, "%=") ||
-          match(TokenKind::Operator, "&=") || match(TokenKind::Operator, "|=") ||
-          match(TokenKind::Operator, "^=") || match(TokenKind::Operator, "<<=") ||
-          match(TokenKind::Operator, ">>=")) {
+      if (match_assign_op()) {
         std::string op = current().text();
         advance();
         auto value = parse_expr();
@@ -1260,7 +1254,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       expect(TokenKind::Punctuation, ";");
       return std::make_unique<ExprStmtAST>(std::move(lhs_expr), tok.position());
     } else if (tok.text() == "static") {
-      std::cerr << "Keyword not supported: static at position " << current().position();
+      std::cerr << "Keyword not supported: static at " << where(current().position());
       throw std::runtime_error("Keyword not supported: static");
     } else if (tok.text() == "struct") {
       advance();
@@ -1288,12 +1282,13 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       }
 
       expect(TokenKind::Punctuation, "}");
+      ++type_decls;
       return std::make_unique<StructStmtAST>(name, std::move(fields), tok.position());
     } else if (tok.text() == "super") {
-      std::cerr << "Keyword not supported: super at position " << current().position();
+      std::cerr << "Keyword not supported: super at " << where(current().position());
       throw std::runtime_error("Keyword not supported: super");
     } else if (tok.text() == "trait") {
-      std::cerr << "Keyword not supported: trait at position " << current().position();
+      std::cerr << "Keyword not supported: trait at " << where(current().position());
       throw std::runtime_error("Keyword not supported: trait");
     } else if (tok.text() == "true" || tok.text() == "false") {
       // 将布尔字面量作为表达式处理
@@ -1301,16 +1296,16 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       expect(TokenKind::Punctuation, ";");
       return std::make_unique<ExprStmtAST>(std::move(expr), tok.position());
     } else if (tok.text() == "type") {
-      std::cerr << "Keyword not supported: type at position " << current().position();
+      std::cerr << "Keyword not supported: type at " << where(current().position());
       throw std::runtime_error("Keyword not supported: type");
     } else if (tok.text() == "unsafe") {
-      std::cerr << "Keyword not supported: unsafe at position " << current().position();
+      std::cerr << "Keyword not supported: unsafe at " << where(current().position());
       throw std::runtime_error("Keyword not supported: unsafe");
     } else if (tok.text() == "use") {
-      std::cerr << "Keyword not supported: use at position " << current().position();
+      std::cerr << "Keyword not supported: use at " << where(current().position());
       throw std::runtime_error("Keyword not supported: use");
     } else if (tok.text() == "where") {
-      std::cerr << "Keyword not supported: where at position " << current().position();
+      std::cerr << "Keyword not supported: where at " << where(current().position());
       throw std::runtime_error("Keyword not supported: where");
     } else if (tok.text() == "while") {
       advance();
@@ -1325,7 +1320,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
       }
       return std::make_unique<WhileStmtAST>(std::move(cond), std::move(body), tok.position());
     } else {
-      std::cerr << "Unknow Keyword: " << tok.text() << " at position " << tok.position() << '\n';
+      std::cerr << "Unknow Keyword: " << tok.text() << " at " << where(tok.position()) << '\n';
       throw std::runtime_error("Unknow Keyword");
     }
   } else if (tok.kind() == TokenKind::Identifier || tok.kind() == TokenKind::Operator) {
@@ -1333,12 +1328,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
     auto lhs_expr = parse_value();
     
     // 检查是否是赋值语句
-    if (match(TokenKind::Operator, "=") || match(TokenKind::Operator, "+=") ||
-        match(TokenKind::Operator, "-=") || match(TokenKind::Operator, "*=") ||
-        match(TokenKind::Operator, "/=") || match(TokenKind::Operator, "%=") ||
-        match(TokenKind::Operator, "&=") || match(TokenKind::Operator, "|=") ||
-        match(TokenKind::Operator, "^=") || match(TokenKind::Operator, "<<=") ||
-        match(TokenKind::Operator, ">>=")) {
+    if (match_assign_op()) {
       std::string op = current().text();
       advance();
       auto value = parse_expr();
@@ -1355,7 +1345,7 @@ std::unique_ptr<StmtAST> Parser::parse_stmt() {
   }
 
   // 默认情况下不到达这里
-  std::cerr << "Unexpected token in parse_stmt: " << tok.text() << " at position " << tok.position() << std::endl;
+  std::cerr << "Unexpected token in parse_stmt: " << tok.text() << " at " << where(tok.position()) << std::endl;
   throw std::runtime_error("Unexpected token in parse_stmt");
   return nullptr;
 }
@@ -1383,7 +1373,7 @@ std::unique_ptr<ExprAST> Parser::parse_value() {
           } else if (match(TokenKind::Punctuation, ")")) {
             break;
           } else {
-            std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+            std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
             throw std::runtime_error("Expected ',' or ')' in function arguments");
           }
         }
@@ -1399,11 +1389,11 @@ std::unique_ptr<ExprAST> Parser::parse_value() {
         // 例如 foo().goo()，这里我们需要将foo()作为对象，goo作为方法名
         // 但是当前AST设计不支持这种情况，我们需要修改AST或者使用另一种方式
         // 暂时我们使用成员方法调用的方式来处理
-        std::cerr << "Consecutive function calls like foo().goo() are not directly supported at position " << current().position() << std::endl;
+        std::cerr << "Consecutive function calls like foo().goo() are not directly supported at " << where(current().position()) << std::endl;
         throw std::runtime_error("Consecutive function calls like foo().goo() are not directly supported");
       } else {
         // 对于其他类型的表达式，我们无法直接创建函数调用
-        std::cerr << "Direct function call on this expression type is not supported at position " << current().position() << std::endl;
+        std::cerr << "Direct function call on this expression type is not supported at " << where(current().position()) << std::endl;
         throw std::runtime_error("Direct function call on this expression type is not supported");
       }
       continue;
@@ -1423,7 +1413,7 @@ std::unique_ptr<ExprAST> Parser::parse_value() {
       advance();
       if (current().kind() != TokenKind::Identifier && 
           !(current().kind() == TokenKind::Keyword && current().text() == "self")) {
-        std::cerr << "Expected identifier after '.' at position " << current().position() << std::endl;
+        std::cerr << "Expected identifier after '.' at " << where(current().position()) << std::endl;
         throw std::runtime_error("Expected identifier after '.'");
       }
       string member_name = current().text();
@@ -1445,7 +1435,7 @@ std::unique_ptr<ExprAST> Parser::parse_value() {
             } else if (match(TokenKind::Punctuation, ")")) {
               break;
             } else {
-              std::cerr << "Expected ',' or ')' in function arguments at position " << current().position() << std::endl;
+              std::cerr << "Expected ',' or ')' in function arguments at " << where(current().position()) << std::endl;
               throw std::runtime_error("Expected ',' or ')' in function arguments");
             }
           }
@@ -1492,55 +1482,28 @@ std::unique_ptr<BlockStmtAST> Parser::parse_block() {
       (current().kind() == TokenKind::Keyword && (current().text() == "true" || current().text() == "false" ||
                    current().text() == "self" || current().text() == "Self" ||
                    current().text() == "loop"))) {
-
-      // 保存当前位置，以便回退
-      int saved_pos = pos;
-
-      // 尝试解析表达式
+      size_t stmt_pos = current().position();
       std::unique_ptr<ExprAST> expr = nullptr;
-      
-      // 特殊处理if表达式
-      if (current().kind() == TokenKind::Keyword && current().text() == "if") {
-        // 尝试解析if表达式
-        int saved_pos_if = pos;
-        expr = parse_if_expr();
-        // 如果解析失败，回退
-        if (!expr) {
-          pos = saved_pos_if;
-          expr = nullptr;
-        }
-      }
-      
-      // 特殊处理loop表达式
-      if (!expr && current().kind() == TokenKind::Keyword && current().text() == "loop") {
-        // 尝试解析loop表达式
-        int saved_pos_loop = pos;
+
+      if (current().kind() == TokenKind::Keyword && current().text() == "loop") {
         expr = parse_loop_expr();
-        // 如果解析失败，回退
-        if (!expr) {
-          pos = saved_pos_loop;
-          expr = nullptr;
+      } else if (current().kind() == TokenKind::Identifier || current().kind() == TokenKind::Operator ||
+                 (current().kind() == TokenKind::Keyword && current().text() == "self")) {
+        // 可能是赋值语句：先按左值解析首个操作数，看到赋值运算符就直接构造赋值，
+        // 否则把它作为首个操作数继续解析表达式，不回退重解析
+        auto lhs_expr = parse_value();
+        if (match_assign_op()) {
+          std::string op = current().text();
+          advance();
+          auto value = parse_expr();
+          expect(TokenKind::Punctuation, ";");
+          statements.push_back(std::make_unique<AssignStmtAST>(std::move(lhs_expr), std::move(value), stmt_pos, op));
+          continue;
         }
-      }
-      
-      // 如果不是if表达式或if表达式解析失败，尝试解析普通表达式
-      if (!expr) {
+        expr = parse_expr_rest(std::move(lhs_expr));
+      } else {
         expr = parse_expr();
       }
-      
-      // 如果解析失败，回退并按常规语句处理
-      if (!expr) {
-        pos = saved_pos;
-        auto stmt = parse_stmt();
-        statements.push_back(std::move(stmt));
-        continue;
-      }
-      
-      // 检查是否是if表达式
-      bool is_if_expr = dynamic_cast<IfExprAST*>(expr.get()) != nullptr;
-      
-      // 检查是否是loop表达式
-      bool is_loop_expr = dynamic_cast<LoopExprAST*>(expr.get()) != nullptr;
 
       // 检查表达式后面是否是分号或闭合大括号
       if (match(TokenKind::Punctuation, ";")) {
@@ -1557,16 +1520,14 @@ std::unique_ptr<BlockStmtAST> Parser::parse_block() {
         break;
       }
 
-      if (is_if_expr || is_loop_expr) {
+      if (dynamic_cast<IfExprAST*>(expr.get()) != nullptr || dynamic_cast<LoopExprAST*>(expr.get()) != nullptr) {
         // 允许if/loop表达式作为语句使用，即使没有分号
         statements.push_back(std::make_unique<ExprStmtAST>(std::move(expr), current().position()));
         continue;
       }
 
-      // 其他情况，回退并按常规语句重新解析
-      pos = saved_pos;
-      auto stmt = parse_stmt();
-      statements.push_back(std::move(stmt));
+      // 其他情况不是合法语句
+      expect(TokenKind::Punctuation, ";");
     } else {
       // 不是表达式，按常规方式解析语句
       auto stmt = parse_stmt();
@@ -1603,6 +1564,7 @@ std::unique_ptr<ImplStmtAST> Parser::parse_impl() {
   // 解析方法列表
   while (!match(TokenKind::Punctuation, "}")) {
     // 检查是否是 const 方法
+    const size_t first = pos;
     bool is_const = false;
     if (match(TokenKind::Keyword, "const")) {
       advance();
@@ -1616,10 +1578,13 @@ std::unique_ptr<ImplStmtAST> Parser::parse_impl() {
     auto return_type = parse_fn_return_type();
     
     // 解析方法体
+    size_t types_before = type_decls;
     auto body = parse_block();
     
     methods.push_back(std::make_unique<FnStmtAST>(method_name, std::move(params), std::move(return_type), 
                                                 std::move(body), is_const, current().position()));
+    methods.back()->declares_local_types = type_decls != types_before;
+    methods.back()->content_hash = hash_tokens(first, pos);
   }
   
   expect(TokenKind::Punctuation, "}");
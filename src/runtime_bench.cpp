@@ -0,0 +1,536 @@
+// src/runtime_bench.cpp
+// 生成代码的运行时基准：把 IR-1 的每个程序编译成宿主机可执行文件，带 .in 输入重复运行，
+// 记录墙钟时间、用户态指令数（Linux perf_event_open，可用时）以及 IR 与目标文件大小，
+// 并可与保存的 JSON 基线比较，用来量化代码生成优化的效果。
+// 运行时（bench/host_builtin.c）只编译一次，与各程序的目标文件一起链接。
+//
+// 用法：runtime_bench [选项] [过滤子串...]
+//   --runs=N                 每个程序计时运行的次数（默认 5），之前先运行一次检查输出
+//   --compiler-flags=<选项>  额外传给编译器的选项，如 --bitpack-bools
+//   --llc=<命令>             默认 llc
+//   --llc-flags=<选项>       默认 -O2
+//   --cc=<命令>              编译运行时并链接的 C 编译器，默认 cc
+//   --timeout=S              单次运行的超时秒数（默认 8）
+//   --work-dir=<目录>        中间文件目录（默认可执行文件旁的 runtime_bench_work）
+//   --baseline=<文件>        与基线比较，有指令数时按指令数、否则按墙钟时间判定，
+//                            任一程序变慢超过阈值或不再通过即返回 1
+//   --threshold=X            回归阈值，相对变化（默认 0.10，即 10%）
+//   --write-baseline=<文件>  把本次结果写成基线
+#include "benchutil.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifndef _WIN32
+namespace {
+  struct Options {
+    int runs = 5;
+    std::string compilerFlags;
+    std::string llc = "llc";
+    std::string llcFlags = "-O2";
+    std::string cc = "cc";
+    int timeoutSeconds = 8;
+    double threshold = 0.10;
+  };
+
+  struct Program {
+    std::string name;
+    fs::path source;
+    fs::path input; // 没有 .in 时为空，程序从 /dev/null 读
+    fs::path expected; // 没有 .out 时为空，不检查输出
+    std::string status = "ok";
+    size_t irBytes = 0;
+    size_t objBytes = 0;
+    std::vector<double> wall; // 秒
+    std::vector<double> instructions; // 指令数不可用时为空
+  };
+
+  struct RunResult {
+    int waitStatus = 0;
+    double seconds = 0;
+    long long instructions = -1;
+  };
+
+  std::string quote(const fs::path &p) {
+    std::string out = "'";
+    for (char c: p.string()) {
+      if (c == '\'') {
+        out += "'\\''";
+      } else {
+        out += c;
+      }
+    }
+    return out + "'";
+  }
+
+  bool run_shell(const std::string &cmd) {
+    return std::system(cmd.c_str()) == 0;
+  }
+
+  // 与 ir_test 一致：把模块的目标三元组和数据布局换成宿主机的
+  void retarget_to_host(std::string &ir) {
+    auto replace_once = [&](const std::string &from, const std::string &to) {
+      const size_t pos = ir.find(from);
+      if (pos != std::string::npos) ir.replace(pos, from.size(), to);
+    };
+    replace_once("target triple = \"riscv64-unknown-elf\"", "target triple = \"x86_64-pc-linux-gnu\"");
+    replace_once("target datalayout = \"e-m:e-p:64:64-i64:64-i128:128-n64-S128\"",
+                 "target datalayout = \"e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128\"");
+  }
+
+  // 编译器 -> llc 目标文件 -> 与运行时链接；失败时把原因记在 status 中
+  bool build_program(Program &program, const fs::path &compiler, const fs::path &runtimeObj, const fs::path &workDir,
+                     const Options &options) {
+    const fs::path ll = workDir / (program.name + ".ll");
+    const fs::path obj = workDir / (program.name + ".o");
+    const fs::path exe = workDir / program.name;
+    std::string compileCmd = quote(compiler);
+    if (!options.compilerFlags.empty()) compileCmd += " " + options.compilerFlags;
+    compileCmd += " - < " + quote(program.source) + " > " + quote(ll) + " 2>/dev/null";
+    std::string ir;
+    if (!run_shell(compileCmd) || !BenchUtil::read_file(ll.string(), ir) || ir.empty()) {
+      program.status = "compile failed";
+      return false;
+    }
+    program.irBytes = ir.size();
+    retarget_to_host(ir);
+    {
+      std::ofstream out(ll, std::ios::binary | std::ios::trunc);
+      out << ir;
+    }
+    const std::string llcCmd = options.llc + " " + options.llcFlags + " -mtriple=x86_64-pc-linux-gnu -filetype=obj -o " +
+                               quote(obj) + " " + quote(ll) + " 2>/dev/null";
+    if (!run_shell(llcCmd)) {
+      program.status = "llc failed";
+      return false;
+    }
+    std::error_code ec;
+    program.objBytes = static_cast<size_t>(fs::file_size(obj, ec));
+    const std::string linkCmd = options.cc + " -no-pie " + quote(obj) + " " + quote(runtimeObj) + " -o " + quote(exe) +
+                                " 2>/dev/null";
+    if (!run_shell(linkCmd)) {
+      program.status = "link failed";
+      return false;
+    }
+    return true;
+  }
+
+#ifdef __linux__
+  // 只数用户态指令：perf_event_paranoid <= 2 时普通用户即可打开
+  int open_instruction_counter(pid_t pid) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+  }
+#endif
+
+  /**
+   * 运行一次程序：子进程 fork 后先等父进程打开计数器，再 exec；
+   * 计数器在 exec 时开始计数，墙钟时间从放行子进程算到 waitpid 返回
+   * @param counterError 计数器打不开时写入原因
+   */
+  RunResult run_once(const fs::path &exe, const fs::path &input, const fs::path &outputFile, int timeoutSeconds,
+                     std::string &counterError) {
+    RunResult result;
+    int gate[2];
+    if (pipe(gate) != 0) throw std::runtime_error("pipe failed");
+    const pid_t pid = fork();
+    if (pid < 0) throw std::runtime_error("fork failed");
+    if (pid == 0) {
+      close(gate[1]);
+      char go;
+      if (read(gate[0], &go, 1) != 1) _exit(127);
+      close(gate[0]);
+      const int in = open(input.empty() ? "/dev/null" : input.c_str(), O_RDONLY);
+      const int out = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      const int err = open("/dev/null", O_WRONLY);
+      if (in < 0 || out < 0 || err < 0) _exit(127);
+      dup2(in, STDIN_FILENO);
+      dup2(out, STDOUT_FILENO);
+      dup2(err, STDERR_FILENO);
+      alarm(static_cast<unsigned>(timeoutSeconds)); // 跨 exec 保留，超时由 SIGALRM 结束
+      execl(exe.c_str(), exe.c_str(), static_cast<char *>(nullptr));
+      _exit(127);
+    }
+    close(gate[0]);
+    int counter = -1;
+#ifdef __linux__
+    counter = open_instruction_counter(pid);
+    if (counter < 0 && counterError.empty()) counterError = std::string("perf_event_open: ") + std::strerror(errno);
+#else
+    if (counterError.empty()) counterError = "perf_event_open is Linux-only";
+#endif
+    const auto start = std::chrono::steady_clock::now();
+    if (write(gate[1], "x", 1) != 1) {
+      kill(pid, SIGKILL);
+    }
+    close(gate[1]);
+    while (waitpid(pid, &result.waitStatus, 0) < 0 && errno == EINTR) {
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (counter >= 0) {
+      long long count = 0;
+      if (read(counter, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count))) result.instructions = count;
+      close(counter);
+    }
+    return result;
+  }
+
+  // 与 ir_test 相同的宽松比较：忽略末尾换行，必要时忽略全部换行
+  bool output_matches(std::string expected, std::string got) {
+    auto trim_newlines = [](std::string &s) {
+      while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+    };
+    trim_newlines(expected);
+    trim_newlines(got);
+    if (expected == got) return true;
+    auto strip_all_newlines = [](std::string s) {
+      s.erase(std::remove(s.begin(), s.end(), '\n'), s.end());
+      s.erase(std::remove(s.begin(), s.end(), '\r'), s.end());
+      return s;
+    };
+    return strip_all_newlines(expected) == strip_all_newlines(got);
+  }
+
+  std::string describe_failure(int waitStatus, int timeoutSeconds) {
+    if (WIFSIGNALED(waitStatus)) {
+      if (WTERMSIG(waitStatus) == SIGALRM) return "timeout " + std::to_string(timeoutSeconds) + "s";
+      return std::string("signal ") + std::to_string(WTERMSIG(waitStatus));
+    }
+    return "wrong output";
+  }
+
+  void measure_program(Program &program, const fs::path &workDir, const Options &options, std::string &counterError) {
+    const fs::path exe = workDir / program.name;
+    const fs::path outputFile = workDir / (program.name + ".stdout");
+    // 第一次运行只检查输出，不计时；输出不对的程序不计时
+    const RunResult check = run_once(exe, program.input, outputFile, options.timeoutSeconds, counterError);
+    std::string got;
+    std::string expected;
+    BenchUtil::read_file(outputFile.string(), got);
+    const bool killed = WIFSIGNALED(check.waitStatus);
+    if (killed || (!program.expected.empty() && BenchUtil::read_file(program.expected.string(), expected) &&
+                   !output_matches(expected, got))) {
+      program.status = describe_failure(check.waitStatus, options.timeoutSeconds);
+      return;
+    }
+    for (int i = 0; i < options.runs; ++i) {
+      const RunResult run = run_once(exe, program.input, outputFile, options.timeoutSeconds, counterError);
+      program.wall.push_back(run.seconds);
+      if (run.instructions >= 0) program.instructions.push_back(static_cast<double>(run.instructions));
+    }
+    if (program.instructions.size() != program.wall.size()) program.instructions.clear();
+  }
+
+  std::string format_count(double value) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(0) << value;
+    return out.str();
+  }
+
+  void report(const std::vector<Program> &programs, int runs) {
+    std::cout << std::left << std::setw(24) << "program" << std::setw(16) << "status" << std::right << std::setw(11)
+              << "wall(ms)" << std::setw(10) << "p90(ms)" << std::setw(16) << "instructions" << std::setw(10) << "IR(B)"
+              << std::setw(10) << "obj(B)" << "\n";
+    double totalWall = 0;
+    double totalInstructions = 0;
+    size_t totalObj = 0;
+    size_t passed = 0;
+    bool haveInstructions = true;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const Program &program: programs) {
+      std::cout << std::left << std::setw(24) << program.name << std::setw(16) << program.status << std::right;
+      if (program.status != "ok") {
+        std::cout << "\n";
+        continue;
+      }
+      ++passed;
+      const BenchUtil::Stats wall = BenchUtil::summarize(program.wall);
+      const double instructions = BenchUtil::summarize(program.instructions).median;
+      totalWall += wall.median;
+      totalInstructions += instructions;
+      totalObj += program.objBytes;
+      haveInstructions = haveInstructions && !program.instructions.empty();
+      std::cout << std::setw(11) << wall.median * 1e3 << std::setw(10) << wall.p90 * 1e3 << std::setw(16)
+                << (program.instructions.empty() ? "n/a" : format_count(instructions)) << std::setw(10)
+                << program.irBytes << std::setw(10) << program.objBytes << "\n";
+    }
+    std::cout << std::left << std::setw(24) << "total" << std::setw(16)
+              << (std::to_string(passed) + "/" + std::to_string(programs.size()) + " ok") << std::right << std::setw(11)
+              << totalWall * 1e3 << std::setw(10) << "" << std::setw(16)
+              << (haveInstructions && passed ? format_count(totalInstructions) : "n/a") << std::setw(10) << ""
+              << std::setw(10) << totalObj << "\n";
+    std::cout << "(" << runs << " runs per program; wall and instructions are medians)\n\n";
+    std::cout.unsetf(std::ios::floatfield);
+  }
+
+  bool write_baseline(const std::string &path, const std::vector<Program> &programs, const Options &options) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    out << std::setprecision(10) << "{\n  \"version\": 1,\n  \"runs\": " << options.runs
+        << ",\n  \"llc_flags\": " << BenchUtil::json_quote(options.llcFlags)
+        << ",\n  \"compiler_flags\": " << BenchUtil::json_quote(options.compilerFlags) << ",\n  \"programs\": {";
+    bool first = true;
+    for (const Program &program: programs) {
+      if (program.status != "ok") continue; // 基线只收录通过的程序
+      out << (first ? "\n" : ",\n") << "    " << BenchUtil::json_quote(program.name)
+          << ": {\"wall_ms\": " << BenchUtil::summarize(program.wall).median * 1e3;
+      if (!program.instructions.empty()) {
+        out << ", \"instructions\": " << format_count(BenchUtil::summarize(program.instructions).median);
+      }
+      out << ", \"ir_bytes\": " << program.irBytes << ", \"obj_bytes\": " << program.objBytes << "}";
+      first = false;
+    }
+    out << "\n  }\n}\n";
+    return static_cast<bool>(out);
+  }
+
+  std::string format_change(double before, double after) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << std::showpos << (after / before - 1.0) * 100 << "%";
+    return out.str();
+  }
+
+  /**
+   * 逐程序比较；两边都有指令数时按指令数判定回归（比墙钟稳定），否则按墙钟时间
+   * @param listMissing 是否列出基线中有、本次未运行的程序（用过滤子串时不列）
+   * @return 是否存在回归
+   */
+  bool compare_baseline(const BenchUtil::JsonValue &baseline, const std::vector<Program> &programs,
+                        double threshold, bool listMissing) {
+    const BenchUtil::JsonValue *saved = baseline.get("programs");
+    if (!saved || !saved->isObject) throw std::runtime_error("baseline JSON: missing \"programs\"");
+    bool regressed = false;
+    std::cout << "Baseline comparison (threshold " << threshold * 100 << "%)\n";
+    for (const Program &program: programs) {
+      const BenchUtil::JsonValue *old = saved->get(program.name);
+      if (!old) continue;
+      std::cout << "  " << std::left << std::setw(24) << program.name << std::right;
+      if (program.status != "ok") {
+        std::cout << "now " << program.status << "  REGRESSION\n";
+        regressed = true;
+        continue;
+      }
+      const double oldWall = old->number_or("wall_ms", 0);
+      const double wall = BenchUtil::summarize(program.wall).median * 1e3;
+      const double oldInstructions = old->number_or("instructions", 0);
+      const double instructions = BenchUtil::summarize(program.instructions).median;
+      const double oldObj = old->number_or("obj_bytes", 0);
+      bool bad = false;
+      std::ostringstream line;
+      line << std::fixed << std::setprecision(3);
+      if (oldWall > 0) {
+        line << "wall " << oldWall << " -> " << wall << " ms (" << format_change(oldWall, wall) << ")";
+      }
+      if (oldInstructions > 0 && !program.instructions.empty()) {
+        line << "  instr " << format_count(oldInstructions) << " -> " << format_count(instructions) << " ("
+             << format_change(oldInstructions, instructions) << ")";
+        bad = instructions / oldInstructions - 1.0 > threshold;
+      } else if (oldWall > 0) {
+        bad = wall / oldWall - 1.0 > threshold;
+      }
+      if (oldObj > 0) {
+        line << "  obj " << format_count(oldObj) << " -> " << program.objBytes << " B ("
+             << format_change(oldObj, static_cast<double>(program.objBytes)) << ")";
+      }
+      regressed = regressed || bad;
+      std::cout << line.str() << (bad ? "  REGRESSION" : "") << "\n";
+    }
+    for (const auto &[name, value]: saved->members) {
+      if (!listMissing) break;
+      const bool present = std::any_of(programs.begin(), programs.end(), [&](const Program &p) { return p.name == name; });
+      if (!present) std::cout << "  " << std::left << std::setw(24) << name << std::right << "not run\n";
+    }
+    std::cout << (regressed ? "Regressions found" : "No regressions") << "\n";
+    return regressed;
+  }
+
+  // 与 ir_test 相同的查找顺序：先找可执行文件旁边，再找当前目录
+  fs::path find_first_existing(const std::vector<fs::path> &candidates) {
+    for (const auto &candidate: candidates) {
+      std::error_code ec;
+      if (fs::exists(candidate, ec)) return candidate;
+    }
+    return {};
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  std::string baselinePath;
+  std::string writeBaselinePath;
+  std::string workDirArg;
+  std::vector<std::string> filters;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg(argv[i]);
+      if (arg.rfind("--runs=", 0) == 0) {
+        options.runs = std::max(1, std::stoi(arg.substr(7)));
+      } else if (arg.rfind("--compiler-flags=", 0) == 0) {
+        options.compilerFlags = arg.substr(17);
+      } else if (arg.rfind("--llc=", 0) == 0) {
+        options.llc = arg.substr(6);
+      } else if (arg.rfind("--llc-flags=", 0) == 0) {
+        options.llcFlags = arg.substr(12);
+      } else if (arg.rfind("--cc=", 0) == 0) {
+        options.cc = arg.substr(5);
+      } else if (arg.rfind("--timeout=", 0) == 0) {
+        options.timeoutSeconds = std::max(1, std::stoi(arg.substr(10)));
+      } else if (arg.rfind("--work-dir=", 0) == 0) {
+        workDirArg = arg.substr(11);
+      } else if (arg.rfind("--baseline=", 0) == 0) {
+        baselinePath = arg.substr(11);
+      } else if (arg.rfind("--threshold=", 0) == 0) {
+        options.threshold = std::stod(arg.substr(12));
+      } else if (arg.rfind("--write-baseline=", 0) == 0) {
+        writeBaselinePath = arg.substr(17);
+      } else if (arg.rfind("--", 0) == 0) {
+        std::cerr << "Unknown option: " << arg << std::endl;
+        return 2;
+      } else {
+        filters.push_back(arg);
+      }
+    }
+  } catch (const std::exception &) {
+    std::cerr << "Invalid option value" << std::endl;
+    return 2;
+  }
+
+  BenchUtil::JsonValue baseline;
+  if (!baselinePath.empty()) {
+    std::string text;
+    if (!BenchUtil::read_file(baselinePath, text)) {
+      std::cerr << "Cannot open baseline: " << baselinePath << std::endl;
+      return 2;
+    }
+    try {
+      baseline = BenchUtil::parse_json(text);
+    } catch (const std::exception &ex) {
+      std::cerr << ex.what() << std::endl;
+      return 2;
+    }
+  }
+
+  const fs::path exeDir = fs::absolute(argv[0]).parent_path();
+  const fs::path cwd = fs::current_path();
+  const fs::path compiler = find_first_existing({exeDir / "code", exeDir / "compiler", cwd / "build" / "code",
+                                                 cwd / "code"});
+  if (compiler.empty()) {
+    std::cerr << "Cannot find compiler binary (tried ./code, ./build/code next to runtime_bench and in cwd)" << std::endl;
+    return 2;
+  }
+  const fs::path runtimeSource = find_first_existing({cwd / "bench" / "host_builtin.c",
+                                                      exeDir / "bench" / "host_builtin.c",
+                                                      exeDir.parent_path() / "bench" / "host_builtin.c"});
+  if (runtimeSource.empty()) {
+    std::cerr << "Cannot find bench/host_builtin.c (checked relative to cwd and exe dir)" << std::endl;
+    return 2;
+  }
+  const fs::path corpus = find_first_existing({cwd / "test_case" / "IR-1" / "src",
+                                               exeDir / "test_case" / "IR-1" / "src",
+                                               exeDir.parent_path() / "test_case" / "IR-1" / "src"});
+  if (corpus.empty()) {
+    std::cerr << "No test_case/IR-1/src found (checked relative to cwd and exe dir)" << std::endl;
+    return 2;
+  }
+
+  std::vector<Program> programs;
+  std::error_code ec;
+  for (const auto &entry: fs::recursive_directory_iterator(corpus, ec)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".rx") continue;
+    const std::string path = entry.path().string();
+    if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string &f) {
+      return path.find(f) != std::string::npos;
+    })) {
+      continue;
+    }
+    Program program;
+    program.name = entry.path().stem().string();
+    program.source = entry.path();
+    fs::path in = entry.path();
+    in.replace_extension(".in");
+    if (fs::exists(in, ec)) program.input = in;
+    fs::path out = entry.path();
+    out.replace_extension(".out");
+    if (fs::exists(out, ec)) program.expected = out;
+    programs.push_back(std::move(program));
+  }
+  std::sort(programs.begin(), programs.end(), [](const Program &a, const Program &b) { return a.name < b.name; });
+  if (programs.empty()) {
+    std::cerr << "Nothing to benchmark" << std::endl;
+    return 2;
+  }
+
+  const fs::path workDir = workDirArg.empty() ? exeDir / "runtime_bench_work" : fs::path(workDirArg);
+  fs::create_directories(workDir, ec);
+  const fs::path runtimeObj = workDir / "host_builtin.o";
+  if (!run_shell(options.cc + " -O2 -c " + quote(runtimeSource) + " -o " + quote(runtimeObj))) {
+    std::cerr << "Cannot compile runtime: " << runtimeSource << std::endl;
+    return 2;
+  }
+  std::cout << "Using compiler: " << compiler << "\n";
+  std::cout << "Programs: " << programs.size() << ", llc flags: " << options.llcFlags
+            << (options.compilerFlags.empty() ? "" : ", compiler flags: " + options.compilerFlags) << "\n";
+
+  std::string counterError;
+  try {
+    for (Program &program: programs) {
+      if (build_program(program, compiler, runtimeObj, workDir, options)) {
+        measure_program(program, workDir, options, counterError);
+      }
+    }
+  } catch (const std::exception &ex) {
+    std::cerr << ex.what() << std::endl;
+    return 2;
+  }
+  if (!counterError.empty()) std::cout << "Instruction counts unavailable (" << counterError << ")\n";
+  std::cout << "\n";
+  report(programs, options.runs);
+
+  if (!writeBaselinePath.empty()) {
+    if (!write_baseline(writeBaselinePath, programs, options)) {
+      std::cerr << "Cannot write baseline: " << writeBaselinePath << std::endl;
+      return 2;
+    }
+    std::cout << "Wrote baseline: " << writeBaselinePath << "\n";
+  }
+  if (!baselinePath.empty() && compare_baseline(baseline, programs, options.threshold, filters.empty())) {
+    return 1;
+  }
+  return 0;
+}
+#else
+int main() {
+  std::cerr << "runtime_bench requires a POSIX host (fork/exec)" << std::endl;
+  return 1;
+}
+#endif
@@ -1,14 +1,21 @@
 #include "semantic.h"
+#include "timetrace.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cstdlib>
+#include <deque>
+#include <exception>
 #include <iostream>
 #include <fstream>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <functional>
+#include <thread>
+#include <tuple>
 #include <typeinfo>
 
 namespace {
@@ -64,19 +71,6 @@ namespace {
     return text;
   }
 
-  bool parseIntegerLiteral(const std::string &text, int64_t &value) {
-    if (text.empty()) {
-      return false;
-    }
-    char *end = nullptr;
-    long long parsed = std::strtoll(text.c_str(), &end, 10);
-    if (end == text.c_str() || *end != '\0') {
-      return false;
-    }
-    value = static_cast<int64_t>(parsed);
-    return true;
-  }
-
   int deduceIntBitWidth(const std::string &typeName) {
     if (typeName.empty()) {
       return 32;
@@ -106,6 +100,10 @@ bool TypeInfo::equals(const TypeRef &other) const {
   if (!other) {
     return false;
   }
+  // 类型经 TypeFactory 驻留，结构相同即同一对象
+  if (this == other) {
+    return true;
+  }
   if (kind == BaseType::Unknown || other->kind == BaseType::Unknown) {
     return true;
   }
@@ -219,40 +217,87 @@ bool TypeInfo::isNumeric() const {
 //===----------------------------------------------------------------------===//
 
 namespace {
-  TypeRef makeSingleton(BaseType kind, const std::string &name = "") {
-    static std::vector<TypeRef> cache;
-    for (const auto &item: cache) {
-      if (item->kind == kind && item->name == name) {
-        return item;
+  // 哈希驻留（hash-consing）：子类型本身已驻留，按指针参与哈希与比较即可
+  struct TypeKey {
+    BaseType kind;
+    std::string name;
+    std::vector<TypeRef> parameters;
+    TypeRef returnType;
+    TypeRef elementType;
+    bool isMutableRef;
+    bool isUnsigned;
+    int bitWidth;
+    bool hasArrayLength;
+    int64_t arrayLength;
+
+    bool operator==(const TypeKey &other) const = default;
+  };
+
+  struct TypeKeyHash {
+    size_t operator()(const TypeKey &key) const {
+      size_t h = std::hash<int>()(static_cast<int>(key.kind));
+      auto mix = [&h](size_t v) { h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+      mix(std::hash<std::string>()(key.name));
+      for (TypeRef param: key.parameters) {
+        mix(std::hash<TypeRef>()(param));
       }
+      mix(std::hash<TypeRef>()(key.returnType));
+      mix(std::hash<TypeRef>()(key.elementType));
+      mix(static_cast<size_t>(key.isMutableRef) | static_cast<size_t>(key.isUnsigned) << 1 |
+          static_cast<size_t>(key.hasArrayLength) << 2);
+      mix(std::hash<int>()(key.bitWidth));
+      mix(std::hash<int64_t>()(key.arrayLength));
+      return h;
     }
-    auto type = std::make_shared<TypeInfo>();
-    type->kind = kind;
-    type->name = name;
-    cache.push_back(type);
+  };
+
+  // 类型竞技场：deque 追加不移动已有元素，TypeRef 在整次编译内保持有效
+  // 函数体并行分析时多个线程同时驻留：先查线程私有缓存，未命中才加锁访问全局表
+  TypeRef intern(TypeInfo &&proto) {
+    static std::mutex mutex;
+    static std::deque<TypeInfo> arena;
+    static std::unordered_map<TypeKey, TypeRef, TypeKeyHash> table;
+    thread_local std::unordered_map<TypeKey, TypeRef, TypeKeyHash> cache;
+    TypeKey key{proto.kind, proto.name, proto.parameters, proto.returnType, proto.elementType, proto.isMutableRef,
+                proto.isUnsigned, proto.bitWidth, proto.hasArrayLength, proto.arrayLength};
+    auto hit = cache.find(key);
+    if (hit != cache.end()) {
+      return hit->second;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = table.find(key);
+    TypeRef type = it != table.end() ? it->second : table.emplace(key, &arena.emplace_back(std::move(proto))).first->second;
+    cache.emplace(std::move(key), type);
     return type;
   }
+
+  TypeRef makeSingleton(BaseType kind, const std::string &name = "") {
+    TypeInfo proto;
+    proto.kind = kind;
+    proto.name = name;
+    return intern(std::move(proto));
+  }
+
+  TypeRef makeInt(const std::string &name, bool isUnsigned) {
+    TypeInfo proto;
+    proto.kind = BaseType::Int;
+    proto.name = name;
+    proto.isUnsigned = isUnsigned;
+    proto.bitWidth = deduceIntBitWidth(name);
+    return intern(std::move(proto));
+  }
 }
 
 TypeRef TypeFactory::getInt() {
-  auto type = makeSingleton(BaseType::Int);
-  type->isUnsigned = false;
-  type->bitWidth = deduceIntBitWidth("");
-  return type;
+  return makeInt("", false);
 }
 
 TypeRef TypeFactory::getSignedInt(const std::string &name) {
-  auto type = makeSingleton(BaseType::Int, name);
-  type->isUnsigned = false;
-  type->bitWidth = deduceIntBitWidth(name);
-  return type;
+  return makeInt(name, false);
 }
 
 TypeRef TypeFactory::getUnsignedInt(const std::string &name) {
-  auto type = makeSingleton(BaseType::Int, name);
-  type->isUnsigned = true;
-  type->bitWidth = deduceIntBitWidth(name);
-  return type;
+  return makeInt(name, true);
 }
 
 TypeRef TypeFactory::getBool() {
@@ -280,28 +325,28 @@ TypeRef TypeFactory::getUnknown() {
 }
 
 TypeRef TypeFactory::makeArray(const TypeRef &element, int64_t length, bool hasLength) {
-  auto type = std::make_shared<TypeInfo>();
-  type->kind = BaseType::Array;
-  type->elementType = element ? element : getUnknown();
-  type->hasArrayLength = hasLength;
-  type->arrayLength = hasLength ? length : -1;
-  return type;
+  TypeInfo proto;
+  proto.kind = BaseType::Array;
+  proto.elementType = element ? element : getUnknown();
+  proto.hasArrayLength = hasLength;
+  proto.arrayLength = hasLength ? length : -1;
+  return intern(std::move(proto));
 }
 
 TypeRef TypeFactory::makeReference(const TypeRef &target, bool isMutable) {
-  auto type = std::make_shared<TypeInfo>();
-  type->kind = BaseType::Reference;
-  type->elementType = target ? target : getUnknown();
-  type->isMutableRef = isMutable;
-  return type;
+  TypeInfo proto;
+  proto.kind = BaseType::Reference;
+  proto.elementType = target ? target : getUnknown();
+  proto.isMutableRef = isMutable;
+  return intern(std::move(proto));
 }
 
 TypeRef TypeFactory::makeFunction(const std::vector<TypeRef> &params, const TypeRef &ret) {
-  auto type = std::make_shared<TypeInfo>();
-  type->kind = BaseType::Function;
-  type->parameters = params;
-  type->returnType = ret ? ret : getVoid();
-  return type;
+  TypeInfo proto;
+  proto.kind = BaseType::Function;
+  proto.parameters = params;
+  proto.returnType = ret ? ret : getVoid();
+  return intern(std::move(proto));
 }
 
 TypeRef TypeFactory::makeStruct(const std::string &name) {
@@ -319,50 +364,62 @@ TypeRef TypeFactory::makeCustom(const std::string &name) {
   return makeSingleton(BaseType::Custom, name);
 }
 
+TypeRef TypeFactory::intern(const TypeInfo &proto) {
+  return ::intern(TypeInfo(proto));
+}
+
 //===----------------------------------------------------------------------===//
 // SymbolTable
 //===----------------------------------------------------------------------===//
 
 void SymbolTable::enterScope() {
-  scopes_.emplace_back();
+  scopeMarks_.push_back(bindings_.size());
 }
 
 void SymbolTable::exitScope() {
-  if (!scopes_.empty()) {
-    scopes_.pop_back();
+  if (scopeMarks_.empty()) {
+    return;
+  }
+  // 按撤销日志倒序弹出本层绑定，恢复各名字被遮蔽的外层绑定
+  size_t mark = scopeMarks_.back();
+  scopeMarks_.pop_back();
+  while (bindings_.size() > mark) {
+    const auto &binding = bindings_.back();
+    heads_[binding.symbol.name] = binding.shadowed;
+    bindings_.pop_back();
   }
 }
 
 bool SymbolTable::addSymbol(const Symbol &symbol, bool allowShadow) {
-  if (scopes_.empty()) {
-    scopes_.emplace_back();
+  if (scopeMarks_.empty()) {
+    enterScope();
   }
   // Allow shadowing by always updating the current scope entry if it exists.
-  auto &current = scopes_.back();
-  current[symbol.name] = symbol;
+  int &head = heads_.try_emplace(symbol.name, -1).first->second;
+  if (head >= 0 && bindings_[head].depth == scopeMarks_.size()) {
+    bindings_[head].symbol = symbol;
+    return true;
+  }
+  bindings_.push_back(Binding{symbol, scopeMarks_.size(), head});
+  head = static_cast<int>(bindings_.size() - 1);
   return true;
 }
 
 const Symbol *SymbolTable::lookup(const std::string &name) const {
-  for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
-    auto found = it->find(name);
-    if (found != it->end()) {
-      return &found->second;
-    }
+  auto it = heads_.find(name);
+  if (it == heads_.end() || it->second < 0) {
+    return nullptr;
   }
-  return nullptr;
+  return &bindings_[it->second].symbol;
 }
 
 const Symbol *SymbolTable::lookupCurrent(const std::string &name) const {
-  if (scopes_.empty()) {
-    return nullptr;
-  }
-  const auto &current = scopes_.back();
-  auto it = current.find(name);
-  if (it == current.end()) {
+  auto it = heads_.find(name);
+  if (it == heads_.end() || it->second < 0) {
     return nullptr;
   }
-  return &it->second;
+  const auto &binding = bindings_[it->second];
+  return binding.depth == scopeMarks_.size() ? &binding.symbol : nullptr;
 }
 
 //===----------------------------------------------------------------------===//
@@ -373,16 +430,32 @@ SemanticAnalyzer::SemanticAnalyzer() {
   reset();
 }
 
+SemanticAnalyzer::SemanticAnalyzer(SemanticAnalyzer *parent)
+  : symbols(parent->symbols), lineIndex(parent->lineIndex), constIntValues(parent->constIntValues), root(parent) {
+}
+
 bool SemanticAnalyzer::analyze(BlockStmtAST *program) {
   // Full semantic pipeline: collect declarations first, then analyze bodies so forward references work.
   reset();
   if (!program) {
     return true;
   }
-  collectConstDeclarations(program);
-  collectTypeDeclarations(program);
-  collectFunctionDeclarations(program);
-  analyzeTopLevel(program);
+  {
+    TimeTrace::Scope scope("CollectConsts");
+    collectConstDeclarations(program);
+  }
+  {
+    TimeTrace::Scope scope("CollectTypes");
+    collectTypeDeclarations(program);
+  }
+  {
+    TimeTrace::Scope scope("CollectFunctions");
+    collectFunctionDeclarations(program);
+  }
+  {
+    TimeTrace::Scope scope("AnalyzeTopLevel");
+    analyzeTopLevel(program);
+  }
   return issues.empty();
 }
 
@@ -429,11 +502,116 @@ void SemanticAnalyzer::collectConstDeclarations(BlockStmtAST *program) {
   }
 }
 
+void SemanticAnalyzer::collectLocalTypeDeclarations(StmtAST *stmt) {
+  if (!stmt) {
+    return;
+  }
+  // 与 analyzeBlock 的登记顺序一致：进入代码块时先登记本块的类型，再深入子语句
+  if (auto *block = dynamic_cast<BlockStmtAST *>(stmt)) {
+    for (auto &child: block->statements) {
+      if (auto *structStmt = dynamic_cast<StructStmtAST *>(child.get())) {
+        registerStruct(structStmt);
+      } else if (auto *enumStmt = dynamic_cast<EnumStmtAST *>(child.get())) {
+        registerEnum(enumStmt);
+      }
+    }
+    for (auto &child: block->statements) {
+      collectLocalTypeDeclarations(child.get());
+    }
+  } else if (auto *fn = dynamic_cast<FnStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(fn->body.get());
+  } else if (auto *ifStmt = dynamic_cast<IfStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(ifStmt->cond.get());
+    collectLocalTypeDeclarations(ifStmt->then_branch.get());
+    collectLocalTypeDeclarations(ifStmt->else_branch.get());
+  } else if (auto *whileStmt = dynamic_cast<WhileStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(whileStmt->cond.get());
+    collectLocalTypeDeclarations(whileStmt->body.get());
+  } else if (auto *forStmt = dynamic_cast<ForStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(forStmt->init.get());
+    collectLocalTypeDeclarations(forStmt->cond.get());
+    collectLocalTypeDeclarations(forStmt->incr.get());
+    collectLocalTypeDeclarations(forStmt->body.get());
+  } else if (auto *loopStmt = dynamic_cast<LoopStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(loopStmt->body.get());
+  } else if (auto *exprStmt = dynamic_cast<ExprStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(exprStmt->expr.get());
+  } else if (auto *letStmt = dynamic_cast<LetStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(letStmt->value.get());
+  } else if (auto *assign = dynamic_cast<AssignStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(assign->lhs_expr.get());
+    collectLocalTypeDeclarations(assign->value.get());
+  } else if (auto *constStmt = dynamic_cast<ConstStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(constStmt->value.get());
+  } else if (auto *staticStmt = dynamic_cast<StaticStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(staticStmt->value.get());
+  } else if (auto *returnStmt = dynamic_cast<ReturnStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(returnStmt->value.get());
+  } else if (auto *breakStmt = dynamic_cast<BreakStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(breakStmt->value.get());
+  } else if (auto *exitStmt = dynamic_cast<ExitStmtAST *>(stmt)) {
+    collectLocalTypeDeclarations(exitStmt->value.get());
+  }
+}
+
+void SemanticAnalyzer::collectLocalTypeDeclarations(ExprAST *expr) {
+  if (!expr) {
+    return;
+  }
+  if (auto *ifExpr = dynamic_cast<IfExprAST *>(expr)) {
+    collectLocalTypeDeclarations(ifExpr->cond.get());
+    collectLocalTypeDeclarations(ifExpr->then_branch.get());
+    collectLocalTypeDeclarations(ifExpr->else_branch.get());
+  } else if (auto *blockExpr = dynamic_cast<BlockExprAST *>(expr)) {
+    for (auto &child: blockExpr->statements) {
+      collectLocalTypeDeclarations(child.get());
+    }
+    collectLocalTypeDeclarations(blockExpr->value.get());
+  } else if (auto *loopExpr = dynamic_cast<LoopExprAST *>(expr)) {
+    collectLocalTypeDeclarations(loopExpr->body.get());
+  } else if (auto *retExpr = dynamic_cast<ReturnExprAST *>(expr)) {
+    collectLocalTypeDeclarations(retExpr->value.get());
+  } else if (auto *enumExpr = dynamic_cast<EnumExprAST *>(expr)) {
+    collectLocalTypeDeclarations(enumExpr->value.get());
+  } else if (auto *unary = dynamic_cast<UnaryExprAST *>(expr)) {
+    collectLocalTypeDeclarations(unary->expr.get());
+  } else if (auto *binary = dynamic_cast<BinaryExprAST *>(expr)) {
+    collectLocalTypeDeclarations(binary->left_expr.get());
+    collectLocalTypeDeclarations(binary->right_expr.get());
+  } else if (auto *index = dynamic_cast<ArrayIndexExprAST *>(expr)) {
+    collectLocalTypeDeclarations(index->array_expr.get());
+    collectLocalTypeDeclarations(index->index_expr.get());
+  } else if (auto *member = dynamic_cast<MemberAccessExprAST *>(expr)) {
+    collectLocalTypeDeclarations(member->struct_expr.get());
+  } else if (auto *call = dynamic_cast<CallExprAST *>(expr)) {
+    collectLocalTypeDeclarations(call->object_expr.get());
+    for (auto &arg: call->args) {
+      collectLocalTypeDeclarations(arg.get());
+    }
+  } else if (auto *structExpr = dynamic_cast<StructExprAST *>(expr)) {
+    for (auto &field: structExpr->fields) {
+      collectLocalTypeDeclarations(field.second.get());
+    }
+  } else if (auto *staticCall = dynamic_cast<StaticCallExprAST *>(expr)) {
+    for (auto &arg: staticCall->args) {
+      collectLocalTypeDeclarations(arg.get());
+    }
+  } else if (auto *cast = dynamic_cast<CastExprAST *>(expr)) {
+    collectLocalTypeDeclarations(cast->expr.get());
+  } else if (auto *array = dynamic_cast<ArrayExprAST *>(expr)) {
+    for (auto &element: array->elements) {
+      collectLocalTypeDeclarations(element.get());
+    }
+    collectLocalTypeDeclarations(array->element.get());
+    collectLocalTypeDeclarations(array->count.get());
+  }
+}
+
 void SemanticAnalyzer::registerStruct(StructStmtAST *structStmt) {
   if (!structStmt) {
     return;
   }
-  auto [it, inserted] = structs.emplace(structStmt->name, StructInfo{structStmt->name, {}});
+  auto [it, inserted] = structs.emplace(structStmt->name, StructInfo{structStmt->name, {}, {}, {}});
   if (!inserted) {
     reportError(structStmt->position(), "Duplicate struct '" + structStmt->name + "'");
     return;
@@ -449,6 +627,7 @@ void SemanticAnalyzer::registerStruct(StructStmtAST *structStmt) {
     }
     validateTypeConstraints(fieldType, structStmt->position());
     it->second.fields[field.first] = fieldType;
+    it->second.fieldIndex[field.first] = it->second.orderedFields.size();
     it->second.orderedFields.emplace_back(field.first, fieldType);
   }
 }
@@ -488,13 +667,10 @@ void SemanticAnalyzer::registerLocalFunctionSymbol(FnStmtAST *fn) {
   std::vector<TypeRef> params;
   std::vector<bool> paramMut;
   for (const auto &param: fn->params) {
-    TypeRef type = resolveTypeName(param.second, currentImplType);
-    if (!type) {
-      type = TypeFactory::getUnknown();
-    }
+    TypeRef type = resolveParamType(param.get(), currentImplType);
     validateTypeConstraints(type, fn->position());
     params.push_back(type);
-    paramMut.push_back(param.first ? param.first->is_mut : false);
+    paramMut.push_back(param ? param->is_mut : false);
   }
 
   TypeRef ret = fn->return_type ? resolveType(fn->return_type.get(), currentImplType) : TypeFactory::getVoid();
@@ -509,13 +685,15 @@ void SemanticAnalyzer::registerLocalFunctionSymbol(FnStmtAST *fn) {
   }
 
   // Also register into global function table so IR generation can retrieve signature for local functions.
-  if (!functions.count(fn->name)) {
+  // worker 不能写共享表，先记在 localFunctions，汇合时再并入
+  auto &table = root == this ? functions : localFunctions;
+  if (!root->functions.count(fn->name) && !table.count(fn->name)) {
     FunctionInfo info;
     info.name = fn->name;
     info.params = params;
     info.paramMut = paramMut;
     info.returnType = ret;
-    functions[fn->name] = info;
+    table[fn->name] = info;
   }
 }
 
@@ -551,35 +729,22 @@ void SemanticAnalyzer::registerFunction(FnStmtAST *fn, const std::string &ownerT
   std::vector<TypeRef> params;
   std::vector<bool> paramMut;
   bool hasSelf = false;
-  TypeRef receiver;
+  TypeRef receiver = nullptr;
   bool selfIsRefParam = false;
   bool selfIsMutParam = false;
   for (size_t i = 0; i < fn->params.size(); ++i) {
     const auto &param = fn->params[i];
-    TypeRef type;
-    if (param.first && param.first->type) {
-      // Prefer the parsed TypeAST so array lengths are preserved.
-      type = resolveType(param.first->type.get(), ownerType);
-    }
-    if (!type && !param.second.empty()) {
-      type = resolveTypeName(param.second, ownerType);
-    }
-    if (param.first && param.first->is_ref) {
-      type = TypeFactory::makeReference(type ? type : TypeFactory::getUnknown(), param.first->is_mut);
-    }
-    if (!type) {
-      type = TypeFactory::getUnknown();
-    }
-    if (i == 0 && param.first && param.first->name == "self" && !ownerType.empty()) {
+    TypeRef type = resolveParamType(param.get(), ownerType);
+    if (i == 0 && param && param->name == "self" && !ownerType.empty()) {
       hasSelf = true;
       receiver = TypeFactory::makeStruct(ownerType);
-      selfIsRefParam = param.first->is_ref;
-      selfIsMutParam = param.first->is_mut;
+      selfIsRefParam = param->is_ref;
+      selfIsMutParam = param->is_mut;
       continue;
     }
     validateTypeConstraints(type, fn->position());
     params.push_back(type);
-    paramMut.push_back(param.first ? param.first->is_mut : false);
+    paramMut.push_back(param ? param->is_mut : false);
   }
 
   TypeRef ret = fn->return_type ? resolveType(fn->return_type.get(), ownerType) : TypeFactory::getVoid();
@@ -634,28 +799,111 @@ void SemanticAnalyzer::analyzeTopLevel(BlockStmtAST *program) {
   if (!program) {
     return;
   }
+  // 声明收集完成后各函数体互不依赖，攒成一批并行分析；
+  // 其余顶层语句会改变全局作用域，遇到时先分析完之前的函数体再按顺序处理它
+  std::vector<std::pair<FnStmtAST *, std::string> > jobs;
   for (auto &stmt: program->statements) {
     if (dynamic_cast<StructStmtAST *>(stmt.get()) || dynamic_cast<EnumStmtAST *>(stmt.get())) {
       continue;
     }
     if (auto *fn = dynamic_cast<FnStmtAST *>(stmt.get())) {
-      analyzeFunctionBody(fn);
+      jobs.emplace_back(fn, "");
     } else if (auto *impl = dynamic_cast<ImplStmtAST *>(stmt.get())) {
       for (auto &method: impl->methods) {
-        currentImplType = impl->type_name;
-        analyzeFunctionBody(method.get(), impl->type_name);
-        currentImplType.clear();
+        jobs.emplace_back(method.get(), impl->type_name);
       }
     } else {
+      analyzeFunctionBodies(jobs);
+      jobs.clear();
       analyzeStatement(stmt.get());
     }
   }
+  analyzeFunctionBodies(jobs);
+}
+
+void SemanticAnalyzer::analyzeFunctionBodies(const std::vector<std::pair<FnStmtAST *, std::string> > &jobs) {
+  if (jobs.empty()) {
+    return;
+  }
+  struct BodyResult {
+    std::vector<SemanticIssue> issues;
+    std::unordered_map<std::string, FunctionInfo> localFunctions;
+    std::unordered_map<std::string, int64_t> localConsts;
+  };
+  // 局部类型会写共享的声明表，开工前由主分析器按声明顺序登记（Parser 已标出含局部类型的函数）
+  for (const auto &job: jobs) {
+    if (job.first->declares_local_types) {
+      collectLocalTypeDeclarations(job.first);
+    }
+  }
+  std::vector<BodyResult> results(jobs.size());
+  std::atomic<size_t> next{0};
+
+  // 每个线程一个 worker：作用域栈、诊断和当前函数上下文都是私有的，按原子计数领取下一个函数体
+  auto drain = [&]() {
+    SemanticAnalyzer worker(this);
+    for (size_t i = next.fetch_add(1); i < jobs.size(); i = next.fetch_add(1)) {
+      worker.currentImplType = jobs[i].second;
+      worker.analyzeFunctionBody(jobs[i].first, jobs[i].second);
+      worker.currentImplType.clear();
+      results[i].issues = std::move(worker.issues);
+      results[i].localFunctions = std::move(worker.localFunctions);
+      results[i].localConsts = std::move(worker.localConstValues);
+      worker.issues.clear();
+      worker.localFunctions.clear();
+      worker.localConstValues.clear();
+    }
+  };
+
+  // hardware_concurrency 每次都会读系统信息，只查一次
+  static const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  size_t threadCount = workerThreads ? workerThreads : hardwareThreads;
+  threadCount = std::min(threadCount, jobs.size());
+  std::vector<std::exception_ptr> failures(threadCount);
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < threadCount; ++t) {
+    pool.emplace_back([&, t]() {
+      try {
+        drain();
+      } catch (...) {
+        failures[t] = std::current_exception();
+      }
+    });
+  }
+  try {
+    drain();
+  } catch (...) {
+    failures[0] = std::current_exception();
+  }
+  for (auto &thread: pool) {
+    thread.join();
+  }
+  for (auto &failure: failures) {
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  // 按声明顺序合并，结果与线程数无关
+  for (auto &result: results) {
+    issues.insert(issues.end(), std::make_move_iterator(result.issues.begin()),
+                  std::make_move_iterator(result.issues.end()));
+    for (const auto &[name, value]: result.localConsts) {
+      constIntValues[name] = value;
+    }
+    // 节点整体转移，callee 指针保持有效；重名的留在原表里一并保存
+    functions.merge(result.localFunctions);
+    if (!result.localFunctions.empty()) {
+      retiredLocalFunctions.push_back(std::move(result.localFunctions));
+    }
+  }
 }
 
 void SemanticAnalyzer::analyzeFunctionBody(FnStmtAST *fn, const std::string &ownerType) {
   if (!fn || !fn->body) {
     return;
   }
+  TimeTrace::Scope scope("AnalyzeFunction", ownerType, fn->name);
 
   TypeRef ret = fn->return_type ? resolveType(fn->return_type.get(), ownerType) : TypeFactory::getVoid();
   if (!ret) {
@@ -677,28 +925,16 @@ void SemanticAnalyzer::analyzeFunctionBody(FnStmtAST *fn, const std::string &own
   symbols.enterScope();
   for (size_t i = 0; i < fn->params.size(); ++i) {
     const auto &param = fn->params[i];
-    if (!param.first) {
+    if (!param) {
       continue;
     }
-    TypeRef type;
-    if (param.first->type) {
-      type = resolveType(param.first->type.get(), currentImplType);
-    }
-    if (!type) {
-      type = resolveTypeName(param.second, currentImplType);
-    }
-    if (param.first->is_ref) {
-      type = TypeFactory::makeReference(type ? type : TypeFactory::getUnknown(), param.first->is_mut);
-    }
-    if (!type) {
-      type = TypeFactory::getUnknown();
-    }
-    if (param.first->name == "self" && !currentImplType.empty()) {
+    TypeRef type = resolveParamType(param.get(), currentImplType);
+    if (param->name == "self" && !currentImplType.empty()) {
       type = TypeFactory::makeStruct(currentImplType);
     }
-    Symbol symbol{param.first->name, SymbolKind::Variable, type, param.first->is_mut};
+    Symbol symbol{param->name, SymbolKind::Variable, type, param->is_mut};
     if (!symbols.addSymbol(symbol)) {
-      reportError(param.first->pos, "Parameter '" + param.first->name + "' redeclared");
+      reportError(param->pos, "Parameter '" + param->name + "' redeclared");
     }
   }
 
@@ -713,10 +949,7 @@ void SemanticAnalyzer::analyzeFunctionBody(FnStmtAST *fn, const std::string &own
         auto *tailExpr = exprStmt->expr.get();
         if (tailExpr) {
           tailProvidesReturn = true;
-          auto tailType = getCachedExprType(tailExpr);
-          if (!tailType) {
-            tailType = analyzeExpr(tailExpr);
-          }
+          auto tailType = analyzeExpr(tailExpr);
           ensureAssignable(tailType, currentReturn, exprStmt->position(), tailExpr);
         }
       }
@@ -868,10 +1101,8 @@ void SemanticAnalyzer::analyzeLet(LetStmtAST *stmt, bool isConst) {
   }
 
   // Resolve annotation (if any) before inspecting initializer so we can enforce assignability in both directions.
-  TypeRef annotated;
-  if (!stmt->type.empty()) {
-    annotated = resolveTypeName(stmt->type, currentImplType);
-  } else if (pattern->type) {
+  TypeRef annotated = nullptr;
+  if (pattern->type) {
     annotated = resolveType(pattern->type.get(), currentImplType);
   }
   if (annotated) {
@@ -922,13 +1153,13 @@ void SemanticAnalyzer::analyzeConst(ConstStmtAST *stmt) {
   if (finalType && finalType->kind == BaseType::Int && stmt->value) {
     int64_t constValue = 0;
     if (tryEvaluateConstInt(stmt->value.get(), constValue)) {
-      constIntValues[stmt->name] = constValue;
+      (root == this ? constIntValues : localConstValues)[stmt->name] = constValue;
     }
   }
 }
 
 void SemanticAnalyzer::analyzeStatic(StaticStmtAST *stmt) {
-  TypeRef annotated = !stmt->type.empty() ? resolveTypeName(stmt->type, currentImplType) : TypeFactory::getUnknown();
+  TypeRef annotated = stmt->type ? resolveType(stmt->type.get(), currentImplType) : TypeFactory::getUnknown();
   validateTypeConstraints(annotated, stmt->position());
   if (stmt->value) {
     auto valueType = analyzeExpr(stmt->value.get());
@@ -1096,6 +1327,13 @@ bool SemanticAnalyzer::tryEvaluateConstInt(ExprAST *expr, int64_t &value) const
   if (!expr) {
     return false;
   }
+  if (expr->const_checked) {
+    if (!expr->const_value) {
+      return false;
+    }
+    value = *expr->const_value;
+    return true;
+  }
   if (auto *number = dynamic_cast<NumberExprAST *>(expr)) {
     value = number->value;
     return true;
@@ -1115,6 +1353,11 @@ bool SemanticAnalyzer::tryEvaluateConstInt(ExprAST *expr, int64_t &value) const
     }
   }
   if (auto *var = dynamic_cast<VariableExprAST *>(expr)) {
+    auto local = localConstValues.find(var->name);
+    if (local != localConstValues.end()) {
+      value = local->second;
+      return true;
+    }
     auto it = constIntValues.find(var->name);
     if (it != constIntValues.end()) {
       value = it->second;
@@ -1151,92 +1394,6 @@ bool SemanticAnalyzer::tryEvaluateConstInt(ExprAST *expr, int64_t &value) const
   return false;
 }
 
-bool SemanticAnalyzer::evaluateConstLengthExpr(const std::string &expr, int64_t &value) const {
-  auto skipWs = [&](size_t &idx) {
-    while (idx < expr.size() && std::isspace(static_cast<unsigned char>(expr[idx]))) ++idx;
-  };
-  std::function<bool(size_t &, int64_t &)> parseExpr, parseTerm, parseFactor;
-  parseFactor = [&](size_t &idx, int64_t &out) {
-    skipWs(idx);
-    if (idx >= expr.size()) return false;
-    char c = expr[idx];
-    if (c == '(') {
-      ++idx;
-      if (!parseExpr(idx, out)) return false;
-      skipWs(idx);
-      if (idx >= expr.size() || expr[idx] != ')') return false;
-      ++idx;
-      return true;
-    }
-    if (c == '+' || c == '-') {
-      ++idx;
-      int64_t inner = 0;
-      if (!parseFactor(idx, inner)) return false;
-      out = (c == '-') ? -inner : inner;
-      return true;
-    }
-    if (std::isdigit(static_cast<unsigned char>(c))) {
-      int64_t val = 0;
-      while (idx < expr.size() && std::isdigit(static_cast<unsigned char>(expr[idx]))) {
-        val = val * 10 + (expr[idx] - '0');
-        ++idx;
-      }
-      out = val;
-      return true;
-    }
-    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
-      std::string ident;
-      while (idx < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[idx])) || expr[idx] == '_')) {
-        ident.push_back(expr[idx]);
-        ++idx;
-      }
-      auto it = constIntValues.find(ident);
-      if (it == constIntValues.end()) return false;
-      out = it->second;
-      return true;
-    }
-    return false;
-  };
-  parseTerm = [&](size_t &idx, int64_t &out) {
-    if (!parseFactor(idx, out)) return false;
-    while (true) {
-      skipWs(idx);
-      if (idx >= expr.size()) return true;
-      char op = expr[idx];
-      if (op != '*' && op != '/' && op != '%') return true;
-      ++idx;
-      int64_t rhs = 0;
-      if (!parseFactor(idx, rhs)) return false;
-      if (op == '*') out *= rhs;
-      else if (op == '/') {
-        if (rhs == 0) return false;
-        out /= rhs;
-      } else {
-        if (rhs == 0) return false;
-        out %= rhs;
-      }
-    }
-  };
-  parseExpr = [&](size_t &idx, int64_t &out) {
-    if (!parseTerm(idx, out)) return false;
-    while (true) {
-      skipWs(idx);
-      if (idx >= expr.size()) return true;
-      char op = expr[idx];
-      if (op != '+' && op != '-') return true;
-      ++idx;
-      int64_t rhs = 0;
-      if (!parseTerm(idx, rhs)) return false;
-      if (op == '+') out += rhs; else out -= rhs;
-    }
-  };
-
-  size_t pos = 0;
-  if (!parseExpr(pos, value)) return false;
-  skipWs(pos);
-  return pos == expr.size();
-}
-
 bool SemanticAnalyzer::isNumericLiteral(ExprAST *expr) const {
   if (!expr) {
     return false;
@@ -1399,17 +1556,6 @@ void SemanticAnalyzer::ensureIntLiteralFits(ExprAST *expr, const TypeRef &target
   }
 }
 
-TypeRef SemanticAnalyzer::getCachedExprType(ExprAST *expr) {
-  if (!expr) {
-    return nullptr;
-  }
-  auto it = exprTypes.find(expr);
-  if (it == exprTypes.end()) {
-    return nullptr;
-  }
-  return it->second;
-}
-
 void SemanticAnalyzer::analyzeBreak(BreakStmtAST *stmt) {
   if (loopDepth == 0) {
     reportError(stmt->position(), "'break' used outside of loop");
@@ -1432,11 +1578,14 @@ void SemanticAnalyzer::analyzeBlock(BlockStmtAST *stmt, bool createScope) {
   if (createScope) {
     symbols.enterScope();
   }
-  for (auto &child: stmt->statements) {
-    if (auto *structStmt = dynamic_cast<StructStmtAST *>(child.get())) {
-      registerStruct(structStmt);
-    } else if (auto *enumStmt = dynamic_cast<EnumStmtAST *>(child.get())) {
-      registerEnum(enumStmt);
+  // worker 分析的函数体中，局部类型已由 collectLocalTypeDeclarations 提前登记
+  if (root == this) {
+    for (auto &child: stmt->statements) {
+      if (auto *structStmt = dynamic_cast<StructStmtAST *>(child.get())) {
+        registerStruct(structStmt);
+      } else if (auto *enumStmt = dynamic_cast<EnumStmtAST *>(child.get())) {
+        registerEnum(enumStmt);
+      }
     }
   }
   preRegisterLocalFunctions(stmt);
@@ -1466,13 +1615,19 @@ TypeRef SemanticAnalyzer::analyzeExpr(ExprAST *expr) {
     return TypeFactory::getVoid();
   }
 
-  if (auto cached = getCachedExprType(expr)) {
-    return cached;
+  if (expr->resolved_type) {
+    return expr->resolved_type;
   }
 
   auto remember = [&](const TypeRef &type) -> TypeRef {
     TypeRef recorded = type ? type : TypeFactory::getUnknown();
-    exprTypes[expr] = recorded;
+    expr->resolved_type = recorded;
+    // 子表达式已先行分析并缓存常量值，这里的求值是 O(1) 的
+    int64_t constValue = 0;
+    if (tryEvaluateConstInt(expr, constValue)) {
+      expr->const_value = constValue;
+    }
+    expr->const_checked = true;
     return recorded;
   };
 
@@ -1539,8 +1694,8 @@ TypeRef SemanticAnalyzer::analyzeExpr(ExprAST *expr) {
     return remember(analyzeCastExpr(castExpr));
   }
   if (auto *enumVal = dynamic_cast<EnumValueExprAST *>(expr)) {
-    auto it = enums.find(enumVal->enum_type);
-    if (it == enums.end()) {
+    auto it = root->enums.find(enumVal->enum_type);
+    if (it == root->enums.end()) {
       reportError(expr->position(), "Unknown enum '" + enumVal->enum_type + "'");
       return remember(TypeFactory::getUnknown());
     }
@@ -1747,6 +1902,10 @@ TypeRef SemanticAnalyzer::analyzeCallExpr(CallExprAST *expr) {
     return TypeFactory::getUnknown();
   }
 
+  if (!expr->object_expr) {
+    expr->callee = findFunction(expr->call);
+  }
+
   // Special handling for the builtin exit() call to enforce placement rules.
   if (!expr->object_expr && expr->call == "exit") {
     bool inTopLevelMain = currentImplType.empty() && currentFunctionName == "main";
@@ -1794,6 +1953,8 @@ TypeRef SemanticAnalyzer::analyzeCallExpr(CallExprAST *expr) {
                   + "'");
       return TypeFactory::getUnknown();
     }
+    expr->callee = method;
+    expr->mangled = typeName + "__" + expr->call;
 
     if (method->hasSelf) {
       if (!objectType || !method->receiverType || !objectType->equals(method->receiverType)) {
@@ -1825,9 +1986,9 @@ TypeRef SemanticAnalyzer::analyzeCallExpr(CallExprAST *expr) {
     return method->returnType ? method->returnType : TypeFactory::getVoid();
   }
 
-  FunctionInfo *info = findFunction(expr->call);
+  FunctionInfo *info = expr->callee;
   std::vector<TypeRef> paramTypes;
-  TypeRef fallbackReturn;
+  TypeRef fallbackReturn = nullptr;
   if (info) {
     paramTypes = info->params;
     fallbackReturn = info->returnType;
@@ -1868,12 +2029,14 @@ TypeRef SemanticAnalyzer::analyzeStaticCall(StaticCallExprAST *expr) {
     }
     typeName = currentImplType;
   }
-  auto typeIt = methods.find(typeName);
-  if (typeIt == methods.end() || typeIt->second.find(methodName) == typeIt->second.end()) {
+  auto *found = findMethod(typeName, methodName);
+  if (!found) {
     reportError(expr->position(), "Type '" + typeName + "' has no associated function '" + methodName + "'");
     return TypeFactory::getUnknown();
   }
-  auto &method = typeIt->second[methodName];
+  auto &method = *found;
+  expr->callee = &method;
+  expr->mangled = typeName + "__" + methodName;
   if (method.hasSelf) {
     reportError(expr->position(), "Method '" + methodName + "' requires an instance");
   }
@@ -1889,8 +2052,8 @@ TypeRef SemanticAnalyzer::analyzeStaticCall(StaticCallExprAST *expr) {
 }
 
 TypeRef SemanticAnalyzer::analyzeStructExpr(StructExprAST *expr) {
-  auto it = structs.find(expr->name);
-  if (it == structs.end()) {
+  auto it = root->structs.find(expr->name);
+  if (it == root->structs.end()) {
     return TypeFactory::getUnknown();
   }
   std::unordered_set<std::string> provided;
@@ -1922,8 +2085,8 @@ TypeRef SemanticAnalyzer::analyzeMemberAccess(MemberAccessExprAST *expr) {
     reportError(expr->position(), "Member access requires struct value");
     return TypeFactory::getUnknown();
   }
-  auto it = structs.find(rootType->name);
-  if (it == structs.end()) {
+  auto it = root->structs.find(rootType->name);
+  if (it == root->structs.end()) {
     return TypeFactory::getUnknown();
   }
   auto fieldIt = it->second.fields.find(expr->member_name);
@@ -1931,6 +2094,8 @@ TypeRef SemanticAnalyzer::analyzeMemberAccess(MemberAccessExprAST *expr) {
     reportError(expr->position(), "Struct '" + rootType->name + "' has no field '" + expr->member_name + "'");
     return TypeFactory::getUnknown();
   }
+  expr->owner = &it->second;
+  expr->field_index = static_cast<int>(it->second.fieldIndex.at(expr->member_name));
   return fieldIt->second;
 }
 
@@ -1988,12 +2153,16 @@ TypeRef SemanticAnalyzer::resolveType(TypeAST *typeAst) {
   return resolveType(typeAst, currentImplType);
 }
 
+// 每个类型注解节点只解析一次，结果缓存在 TypeAST::resolved 上供后续查询和 IR 生成复用
 TypeRef SemanticAnalyzer::resolveType(TypeAST *typeAst, const std::string &selfType) {
   if (!typeAst) {
     return TypeFactory::getVoid();
   }
+  if (typeAst->resolved) {
+    return typeAst->resolved;
+  }
   if (auto *prim = dynamic_cast<PrimitiveTypeAST *>(typeAst)) {
-    return resolveTypeName(prim->name, selfType);
+    return typeAst->resolved = resolveTypeName(prim->name, selfType);
   }
   if (auto *arr = dynamic_cast<ArrayTypeAST *>(typeAst)) {
     auto elem = resolveType(arr->element_type.get(), selfType);
@@ -2002,18 +2171,27 @@ TypeRef SemanticAnalyzer::resolveType(TypeAST *typeAst, const std::string &selfT
     if (arr->size_expr && !hasLen) {
       reportError(arr->size_expr->position(), "Array size must be a constant expression");
     }
-    return TypeFactory::makeArray(elem, lengthValue, hasLen);
+    return typeAst->resolved = TypeFactory::makeArray(elem, lengthValue, hasLen);
   }
   if (auto *refType = dynamic_cast<ReferenceTypeAST *>(typeAst)) {
     auto target = resolveType(refType->referenced_type.get(), selfType);
-    return TypeFactory::makeReference(target, refType->is_mutable);
+    return typeAst->resolved = TypeFactory::makeReference(target, refType->is_mutable);
   }
   if (auto *tupleType = dynamic_cast<TupleTypeAST *>(typeAst)) {
     if (tupleType->elements.empty()) {
-      return TypeFactory::getVoid();
+      return typeAst->resolved = TypeFactory::getVoid();
     }
   }
-  return TypeFactory::makeCustom(typeAst->toString());
+  return typeAst->resolved = TypeFactory::makeCustom(typeAst->toString());
+}
+
+// 参数类型：模式上的 & / &mut 修饰包在注解类型外层
+TypeRef SemanticAnalyzer::resolveParamType(IdentPatternAST *param, const std::string &selfType) {
+  TypeRef type = (param && param->type) ? resolveType(param->type.get(), selfType) : nullptr;
+  if (param && param->is_ref) {
+    type = TypeFactory::makeReference(type ? type : TypeFactory::getUnknown(), param->is_mut);
+  }
+  return type ? type : TypeFactory::getUnknown();
 }
 
 TypeRef SemanticAnalyzer::resolveTypeName(const std::string &raw, const std::string &selfType) {
@@ -2026,62 +2204,6 @@ TypeRef SemanticAnalyzer::resolveTypeName(const std::string &raw, const std::str
     return TypeFactory::getVoid();
   }
 
-  // 引用类型（&T 或 &mut T）
-  if (name[0] == '&') {
-    size_t idx = 1;
-    while (idx < name.size() && std::isspace(static_cast<unsigned char>(name[idx]))) {
-      ++idx;
-    }
-    bool isMut = false;
-    if (name.compare(idx, 3, "mut") == 0) {
-      isMut = true;
-      idx += 3;
-    }
-    while (idx < name.size() && std::isspace(static_cast<unsigned char>(name[idx]))) {
-      ++idx;
-    }
-    auto target = resolveTypeName(name.substr(idx), selfType);
-    return TypeFactory::makeReference(target ? target : TypeFactory::getUnknown(), isMut);
-  }
-
-  // 数组类型（[T; N] 或 [[T; M]; N]），这里只关心元素类型
-  if (name[0] == '[') {
-    size_t depth = 0;
-    size_t separator = std::string::npos;
-    size_t close = std::string::npos;
-    for (size_t i = 1; i < name.size(); ++i) {
-      char c = name[i];
-      if (c == '[') {
-        ++depth;
-      } else if (c == ']') {
-        if (depth == 0) {
-          close = i;
-          break;
-        }
-        --depth;
-      } else if (c == ';' && depth == 0 && separator == std::string::npos) {
-        separator = i;
-      }
-    }
-    if (close != std::string::npos) {
-      size_t elementEnd = (separator != std::string::npos) ? separator : close;
-      if (elementEnd > 1) {
-        auto elementPart = name.substr(1, elementEnd - 1);
-        auto elementType = resolveTypeName(elementPart, selfType);
-        int64_t lengthValue = -1;
-        bool hasLength = false;
-        if (separator != std::string::npos && close > separator + 1) {
-          auto lengthPart = trim(name.substr(separator + 1, close - separator - 1));
-          hasLength = parseIntegerLiteral(lengthPart, lengthValue);
-          if (!hasLength) {
-            hasLength = evaluateConstLengthExpr(lengthPart, lengthValue);
-          }
-        }
-        return TypeFactory::makeArray(elementType ? elementType : TypeFactory::getUnknown(), lengthValue, hasLength);
-      }
-    }
-  }
-
   auto lowered = toLower(name);
   if (lowered == "void") {
     return TypeFactory::getVoid();
@@ -2107,23 +2229,27 @@ TypeRef SemanticAnalyzer::resolveTypeName(const std::string &raw, const std::str
     return TypeFactory::getChar();
   }
   if (name == "Self" && !selfType.empty()) {
-    auto structIt = structs.find(selfType);
-    if (structIt != structs.end()) {
+    auto structIt = root->structs.find(selfType);
+    if (structIt != root->structs.end()) {
       return TypeFactory::makeStruct(selfType);
     }
     return TypeFactory::makeCustom(selfType);
   }
-  if (structs.count(name)) {
+  if (root->structs.count(name)) {
     return TypeFactory::makeStruct(name);
   }
-  if (enums.count(name)) {
+  if (root->enums.count(name)) {
     return TypeFactory::makeEnum(name);
   }
   return TypeFactory::makeCustom(name);
 }
 
 void SemanticAnalyzer::reportError(size_t position, const std::string &msg) {
-  issues.push_back({msg, position});
+  SemanticIssue issue{msg, position};
+  if (lineIndex) {
+    std::tie(issue.line, issue.column) = lineIndex->lookup(position);
+  }
+  issues.push_back(std::move(issue));
 }
 
 bool SemanticAnalyzer::ensureAssignable(const TypeRef &from, const TypeRef &to, size_t position, ExprAST *originExpr) {
@@ -2204,11 +2330,11 @@ bool SemanticAnalyzer::ensureAssignable(const TypeRef &from, const TypeRef &to,
       // 检查是否在impl块中，并且一个是Self一个是具体类型
       if (!currentImplType.empty()) {
         // 如果from是Self类型（名称为currentImplType），to也是结构体类型
-        if (from->name == currentImplType && structs.count(to->name)) {
+        if (from->name == currentImplType && root->structs.count(to->name)) {
           return true;
         }
         // 如果to是Self类型（名称为currentImplType），from也是结构体类型
-        if (to->name == currentImplType && structs.count(from->name)) {
+        if (to->name == currentImplType && root->structs.count(from->name)) {
           return true;
         }
       }
@@ -2289,16 +2415,20 @@ TypeRef SemanticAnalyzer::stripReference(const TypeRef &type) const {
 }
 
 FunctionInfo *SemanticAnalyzer::findFunction(const std::string &name) {
-  auto it = functions.find(name);
-  if (it == functions.end()) {
+  auto it = root->functions.find(name);
+  if (it != root->functions.end()) {
+    return &it->second;
+  }
+  auto local = localFunctions.find(name);
+  if (local == localFunctions.end()) {
     return nullptr;
   }
-  return &it->second;
+  return &local->second;
 }
 
 FunctionInfo *SemanticAnalyzer::findMethod(const std::string &typeName, const std::string &methodName) {
-  auto it = methods.find(typeName);
-  if (it == methods.end()) {
+  auto it = root->methods.find(typeName);
+  if (it == root->methods.end()) {
     return nullptr;
   }
   auto inner = it->second.find(methodName);
@@ -2309,8 +2439,8 @@ FunctionInfo *SemanticAnalyzer::findMethod(const std::string &typeName, const st
 }
 
 const StructInfo *SemanticAnalyzer::getStructInfo(const std::string &name) const {
-  auto it = structs.find(name);
-  if (it == structs.end()) {
+  auto it = root->structs.find(name);
+  if (it == root->structs.end()) {
     return nullptr;
   }
   return &it->second;
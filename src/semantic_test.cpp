@@ -90,11 +90,12 @@ void testFile(const std::string& filepath, bool shouldPass) {
         tokens.push_back(Token(TokenKind::Eof, "", 0));
     
         // 2. 语法分析
-        Parser parser(tokens);
+        Parser parser(tokens, &lexer.line_index());
         auto ast = parser.parse_program();
 
         // 3. 语义分析
         SemanticAnalyzer analyzer;
+        analyzer.setLineIndex(&lexer.line_index());
         bool success = analyzer.analyze(ast.get());
         if (success) {
             std::cout << "语义分析成功，没有错误" << std::endl;
@@ -106,7 +107,7 @@ void testFile(const std::string& filepath, bool shouldPass) {
         } else {
             std::cout << "语义分析失败，发现以下错误:" << std::endl;
             for (const auto& error : analyzer.errors()) {
-                std::cout << "  - " << error.message << " (位置: " << error.position << ")" << std::endl;
+                std::cout << "  - " << error.message << " (位置: " << error.line << ":" << error.column << ")" << std::endl;
             }
             if (shouldPass) {
                 std::cout << "❌ 测试失败: 预期通过但语义分析失败" << std::endl;
@@ -0,0 +1,188 @@
+#include "timetrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace TimeTrace {
+  namespace {
+    struct Event {
+      const char *name;
+      std::string detail;
+      int64_t start;
+      int64_t end;
+    };
+
+    // 每个线程一个缓冲区：记录时无需加锁，只有首次登记时加锁
+    struct ThreadBuffer {
+      unsigned tid;
+      std::vector<Event> events;
+    };
+
+    std::mutex g_buffersMutex;
+    std::deque<ThreadBuffer> g_buffers; // deque 追加不移动已有元素，线程缓存的指针保持有效
+    std::chrono::steady_clock::time_point g_origin;
+
+    ThreadBuffer &threadBuffer() {
+      thread_local ThreadBuffer *buffer = nullptr;
+      if (!buffer) {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        buffer = &g_buffers.emplace_back();
+        buffer->tid = static_cast<unsigned>(g_buffers.size() - 1);
+      }
+      return *buffer;
+    }
+
+    // 汇总时所有工作线程都已结束，直接遍历
+    template<class Fn>
+    void forEachEvent(Fn &&fn) {
+      std::lock_guard<std::mutex> lock(g_buffersMutex);
+      for (const auto &buffer: g_buffers) {
+        for (const auto &event: buffer.events) fn(buffer.tid, event);
+      }
+    }
+
+    void writeJsonString(std::ostream &out, std::string_view s) {
+      out << '"';
+      for (char c: s) {
+        if (c == '"' || c == '\\') {
+          out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out << escaped;
+        } else {
+          out << c;
+        }
+      }
+      out << '"';
+    }
+
+    double toMs(int64_t ns) {
+      return static_cast<double>(ns) / 1e6;
+    }
+  }
+
+  namespace detail {
+    bool g_enabled = false;
+    bool g_recordEvents = false;
+    thread_local constinit const char *t_phase = nullptr;
+    PhaseHook g_phaseEndHook = nullptr;
+
+    int64_t now() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_origin).count();
+    }
+
+    void finish(const char *name, std::string &&detail, int64_t start) {
+      if (g_recordEvents) threadBuffer().events.push_back(Event{name, std::move(detail), start, now()});
+      if (g_phaseEndHook) g_phaseEndHook(name);
+    }
+  }
+
+  void enable(bool recordEvents) {
+    if (recordEvents && !detail::g_recordEvents) {
+      g_origin = std::chrono::steady_clock::now();
+      detail::g_recordEvents = true;
+    }
+    detail::g_enabled = true;
+  }
+
+  void setPhaseEndHook(PhaseHook hook) {
+    detail::g_phaseEndHook = hook;
+  }
+
+  bool writeChromeTrace(const std::string &path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    forEachEvent([&](unsigned tid, const Event &event) {
+      out << (first ? "" : ",\n") << "{\"name\":";
+      first = false;
+      writeJsonString(out, event.name);
+      out << ",\"cat\":\"rcompiler\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+          << ",\"ts\":" << static_cast<double>(event.start) / 1e3
+          << ",\"dur\":" << static_cast<double>(event.end - event.start) / 1e3;
+      if (!event.detail.empty()) {
+        out << ",\"args\":{\"detail\":";
+        writeJsonString(out, event.detail);
+        out << "}";
+      }
+      out << "}";
+    });
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(out);
+  }
+
+  void printReport(std::ostream &out) {
+    struct Row {
+      int64_t total = 0;
+      size_t count = 0;
+      int64_t firstStart = 0;
+    };
+    std::map<std::string_view, Row> rows;
+    std::vector<const Event *> functions; // 带 detail 的事件：单个函数等细粒度条目
+    int64_t begin = INT64_MAX;
+    int64_t end = 0;
+    forEachEvent([&](unsigned, const Event &event) {
+      auto [it, inserted] = rows.try_emplace(event.name);
+      if (inserted || event.start < it->second.firstStart) it->second.firstStart = event.start;
+      it->second.total += event.end - event.start;
+      ++it->second.count;
+      if (!event.detail.empty()) functions.push_back(&event);
+      begin = std::min(begin, event.start);
+      end = std::max(end, event.end);
+    });
+    if (rows.empty()) return;
+
+    // 按阶段开始的先后排列，读起来与编译流程一致
+    std::vector<std::pair<std::string_view, Row> > ordered(rows.begin(), rows.end());
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto &a, const auto &b) { return a.second.firstStart < b.second.firstStart; });
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "===----------------------------------------------------------===\n";
+    out << "                    Compile time report\n";
+    out << "===----------------------------------------------------------===\n";
+    out << "  Total wall time: " << toMs(end - begin) << " ms\n\n";
+    out << std::setw(12) << "Total(ms)" << std::setw(9) << "Count" << std::setw(12) << "Avg(ms)" << "  Name\n";
+    for (const auto &[name, row]: ordered) {
+      out << std::setw(12) << toMs(row.total) << std::setw(9) << row.count << std::setw(12)
+          << toMs(row.total) / static_cast<double>(row.count) << "  " << name << "\n";
+    }
+
+    if (!functions.empty()) {
+      constexpr size_t kSlowest = 10;
+      const size_t shown = std::min(kSlowest, functions.size());
+      std::partial_sort(functions.begin(), functions.begin() + static_cast<std::ptrdiff_t>(shown), functions.end(),
+                        [](const Event *a, const Event *b) { return a->end - a->start > b->end - b->start; });
+      out << "\n  Slowest entries:\n";
+      for (size_t i = 0; i < shown; ++i) {
+        out << std::setw(12) << toMs(functions[i]->end - functions[i]->start) << "  " << functions[i]->name << "  "
+            << functions[i]->detail << "\n";
+      }
+    }
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  Session::Session(std::string tracePath, bool report) : tracePath_(std::move(tracePath)), report_(report) {
+    if (!tracePath_.empty() || report_) enable();
+  }
+
+  Session::~Session() {
+    if (!tracePath_.empty() && !writeChromeTrace(tracePath_)) {
+      std::cerr << "Cannot write time trace: " << tracePath_ << std::endl;
+    }
+    if (report_) printReport(std::cerr);
+  }
+}
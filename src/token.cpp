@@ -8,7 +8,7 @@ TokenKind Token::kind() const {
   return kind_;
 }
 
-std::string Token::text() const {
+const std::string &Token::text() const {
   return text_;
 }
 
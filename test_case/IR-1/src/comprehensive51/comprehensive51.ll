@@ -0,0 +1,194 @@
+; Autogenerated textual LLVM IR
+source_filename = "RCompiler"
+
+%struct.Point = type { i64, i64 }
+%struct.Range = type { i64, i32, i32 }
+
+define i64 @bump(ptr %p0, i64 %p1) {
+entry:
+  %t1 = alloca i64
+  store i64 %p1, ptr %t1
+  %t2 = load i64, ptr %t1
+  %t3 = load i64, ptr %p0
+  %t4 = trunc i64 %t3 to i32
+  %t5 = sext i32 %t4 to i64
+  %t6 = trunc i64 %t2 to i32
+  %t7 = sext i32 %t6 to i64
+  %t8 = add i64 %t5, %t7
+  %t9 = trunc i64 %t8 to i32
+  %t10 = sext i32 %t9 to i64
+  store i64 %t10, ptr %p0
+  ret i64 0
+}
+
+define i64 @read_twice(ptr %p0) {
+entry:
+  %t1 = load i64, ptr %p0
+  %t2 = load i64, ptr %p0
+  %t3 = trunc i64 %t1 to i32
+  %t4 = sext i32 %t3 to i64
+  %t5 = trunc i64 %t2 to i32
+  %t6 = sext i32 %t5 to i64
+  %t7 = add i64 %t4, %t6
+  %t8 = trunc i64 %t7 to i32
+  %t9 = sext i32 %t8 to i64
+  ret i64 %t9
+}
+
+define i64 @main() {
+entry:
+  %t2 = alloca i64
+  store i64 0, ptr %t2
+  %t5 = alloca [2 x i64]
+  %t15 = alloca i64
+  store i64 0, ptr %t15
+  %t46 = alloca [2 x i64]
+  %t59 = alloca i64
+  store i64 0, ptr %t59
+  %t109 = alloca i64
+  %t110 = alloca i64
+  %t1 = call i64 @getInt()
+  %t3 = trunc i64 %t1 to i32
+  %t4 = sext i32 %t3 to i64
+  store i64 %t4, ptr %t2
+  %t6 = getelementptr %struct.Point, ptr %t5, i32 0, i32 0
+  %t7 = trunc i64 1 to i32
+  %t8 = sext i32 %t7 to i64
+  store i64 %t8, ptr %t6
+  %t9 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t10 = trunc i64 2 to i32
+  %t11 = sext i32 %t10 to i64
+  store i64 %t11, ptr %t9
+  %t12 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t13 = load i64, ptr %t12
+  %t14 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t16 = ptrtoint ptr %t14 to i64
+  store i64 %t16, ptr %t15
+  %t17 = load i64, ptr %t15
+  %t18 = inttoptr i64 %t17 to ptr
+  %t19 = trunc i64 40 to i32
+  %t20 = sext i32 %t19 to i64
+  store i64 %t20, ptr %t18
+  %t21 = getelementptr %struct.Point, ptr %t5, i32 0, i32 0
+  %t22 = load i64, ptr %t21
+  %t23 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t24 = load i64, ptr %t23
+  %t25 = trunc i64 %t22 to i32
+  %t26 = sext i32 %t25 to i64
+  %t27 = trunc i64 %t24 to i32
+  %t28 = sext i32 %t27 to i64
+  %t29 = add i64 %t26, %t28
+  %t30 = trunc i64 %t29 to i32
+  %t31 = sext i32 %t30 to i64
+  %t32 = call i64 @printlnInt(i64 %t31)
+  %t33 = getelementptr %struct.Point, ptr %t5, i32 0, i32 0
+  %t34 = load i64, ptr %t33
+  %t35 = getelementptr %struct.Point, ptr %t5, i32 0, i32 0
+  %t36 = load i64, ptr %t2
+  %t37 = call i64 @bump(ptr %t35, i64 %t36)
+  %t38 = getelementptr %struct.Point, ptr %t5, i32 0, i32 0
+  %t39 = load i64, ptr %t38
+  %t40 = call i64 @printlnInt(i64 %t39)
+  %t41 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t42 = load i64, ptr %t41
+  %t43 = getelementptr %struct.Point, ptr %t5, i32 0, i32 1
+  %t44 = call i64 @read_twice(ptr %t43)
+  %t45 = call i64 @printlnInt(i64 %t44)
+  %t47 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t48 = trunc i64 0 to i32
+  %t49 = sext i32 %t48 to i64
+  store i64 %t49, ptr %t47
+  %t50 = getelementptr %struct.Range, ptr %t46, i32 0, i32 1
+  %t51 = load i64, ptr %t2
+  %t52 = trunc i64 %t51 to i32
+  %t53 = sext i32 %t52 to i64
+  %t54 = trunc i64 %t53 to i32
+  store i32 %t54, ptr %t50
+  %t55 = getelementptr %struct.Range, ptr %t46, i32 0, i32 2
+  %t56 = trunc i64 3 to i32
+  %t57 = sext i32 %t56 to i64
+  %t58 = trunc i64 %t57 to i32
+  store i32 %t58, ptr %t55
+  %t60 = trunc i64 0 to i32
+  %t61 = sext i32 %t60 to i64
+  store i64 %t61, ptr %t59
+  br label %while1
+while1:
+  %t62 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t63 = load i64, ptr %t62
+  %t64 = getelementptr %struct.Range, ptr %t46, i32 0, i32 1
+  %t65 = load i32, ptr %t64
+  %t66 = sext i32 %t65 to i64
+  %t67 = trunc i64 %t63 to i32
+  %t68 = sext i32 %t67 to i64
+  %t69 = trunc i64 %t66 to i32
+  %t70 = sext i32 %t69 to i64
+  %t71 = icmp slt i64 %t68, %t70
+  %t72 = zext i1 %t71 to i64
+  %t73 = icmp ne i64 %t72, 0
+  br i1 %t73, label %brfar4, label %whileexit3
+brfar4:
+  br label %whilebody2
+whilebody2:
+  %t74 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t75 = load i64, ptr %t74
+  %t76 = load i64, ptr %t59
+  %t77 = trunc i64 %t76 to i32
+  %t78 = sext i32 %t77 to i64
+  %t79 = trunc i64 %t75 to i32
+  %t80 = sext i32 %t79 to i64
+  %t81 = add i64 %t78, %t80
+  %t82 = trunc i64 %t81 to i32
+  %t83 = sext i32 %t82 to i64
+  store i64 %t83, ptr %t59
+  %t84 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t85 = load i64, ptr %t84
+  %t86 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t87 = getelementptr %struct.Range, ptr %t46, i32 0, i32 2
+  %t88 = load i32, ptr %t87
+  %t89 = sext i32 %t88 to i64
+  %t90 = call i64 @bump(ptr %t86, i64 %t89)
+  br label %while1
+whileexit3:
+  %t91 = load i64, ptr %t59
+  %t92 = call i64 @printlnInt(i64 %t91)
+  %t93 = getelementptr %struct.Range, ptr %t46, i32 0, i32 0
+  %t94 = load i64, ptr %t93
+  %t95 = call i64 @printlnInt(i64 %t94)
+  %t96 = load i64, ptr %t2
+  %t97 = trunc i64 %t96 to i32
+  %t98 = sext i32 %t97 to i64
+  %t99 = load i64, ptr %t2
+  %t100 = trunc i64 %t99 to i32
+  %t101 = sext i32 %t100 to i64
+  %t102 = trunc i64 2 to i32
+  %t103 = sext i32 %t102 to i64
+  %t104 = mul i64 %t101, %t103
+  %t105 = trunc i64 %t104 to i32
+  %t106 = sext i32 %t105 to i64
+  %t107 = trunc i64 %t106 to i32
+  %t108 = sext i32 %t107 to i64
+  store i64 %t98, ptr %t109
+  store i64 %t108, ptr %t110
+  %t111 = load i64, ptr %t109
+  %t112 = load i64, ptr %t110
+  %t113 = trunc i64 %t111 to i32
+  %t114 = sext i32 %t113 to i64
+  %t115 = trunc i64 %t112 to i32
+  %t116 = sext i32 %t115 to i64
+  %t117 = add i64 %t114, %t116
+  %t118 = trunc i64 %t117 to i32
+  %t119 = sext i32 %t118 to i64
+  %t120 = call i64 @printlnInt(i64 %t119)
+  ret i64 0
+}
+
+declare i32 @printf(ptr, ...)
+declare i32 @scanf(ptr, ...)
+declare void @exit(i32)
+declare i64 @printInt(i64)
+declare i64 @printlnInt(i64)
+declare i64 @printlnStr(ptr)
+declare i64 @getInt()
+declare void @exit_rt(i64)
+